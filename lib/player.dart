@@ -1,5 +1,8 @@
 import 'dart:async';
+import 'dart:ffi'
+    show DynamicLibrary, NativeFunction, Pointer, Uint8, Uint8Pointer, Void;
 import 'dart:isolate';
+import 'dart:ui' show Offset, Rect;
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 
@@ -15,6 +18,54 @@ class BufferRange {
   const BufferRange(this.begin, this.end);
 }
 
+/// This type is used by [AvMediaPlayer] to show the current A-B loop range.
+class LoopRange {
+  final int begin;
+  final int end;
+  const LoopRange(this.begin, this.end);
+}
+
+/// This type is used by [AvMediaPlayer.open] to enable clip mode.
+/// A media no longer than [maxDuration] milliseconds and no larger than [maxSize] is decoded only once,
+/// all its frames are kept in memory and later loops are played from there without audio.
+/// [Size.zero] means no size limit.
+/// On linux the frames are kept scaled down to fit in [frameSize] with 16 bits per pixel,
+/// [Size.zero] keeps the video size.
+class ClipOptions {
+  final int maxDuration;
+  final Size maxSize;
+  final Size frameSize;
+  const ClipOptions({
+    this.maxDuration = 10000,
+    this.maxSize = const Size(1280, 720),
+    this.frameSize = const Size(640, 360),
+  });
+}
+
+/// This type is used by [AvMediaPlayer.open] to tune how the media is probed before playback.
+/// [probeSize] is in bytes and [analyzeDuration] is in milliseconds, 0 means the default.
+/// [probeInfo] is one of 'yes', 'no', 'auto' and 'nostreams', see the `demuxer-lavf-probe-info` option of mpv.
+/// [format] skips format detection, for example 'mp4' or 'mpegts'.
+class ProbeOptions {
+  final int probeSize;
+  final int analyzeDuration;
+  final String probeInfo;
+  final String? format;
+  const ProbeOptions({
+    this.probeSize = 0,
+    this.analyzeDuration = 0,
+    this.probeInfo = 'auto',
+    this.format,
+  });
+
+  /// For sources known to carry their stream info in the header, like faststart mp4 or plain mpegts.
+  static const fastOpen = ProbeOptions(
+    probeSize: 65536,
+    analyzeDuration: 500,
+    probeInfo: 'nostreams',
+  );
+}
+
 /// This type is used by [TrackInfo] to show the type of the track.
 enum TrackType { audio, video, subtitle }
 
@@ -86,7 +137,220 @@ class MediaInfo {
   final int duration;
   final Map<String, TrackInfo> tracks;
   final String source;
-  const MediaInfo(this.duration, this.tracks, this.source);
+
+  /// The time from opening the media to it being loaded in milliseconds.
+  /// It's only measured on linux, and null until the media is loaded.
+  final int? probeTime;
+  const MediaInfo(this.duration, this.tracks, this.source, {this.probeTime});
+}
+
+/// This type is used by [AvMediaPlayer.probe] to report the result of a source.
+/// Either [mediaInfo] or [error] is non-null.
+class ProbeResult {
+  final String source;
+  final MediaInfo? mediaInfo;
+  final String? error;
+  const ProbeResult(this.source, {this.mediaInfo, this.error});
+}
+
+/// This type is used by [AvMediaPlayer.generateThumbnails] to describe a thumbnail sprite sheet.
+/// The sheet at [path] is a JPEG image with [columns] x [rows] cells of [size] each, in row-major order.
+/// [timestamps] holds the position of the keyframe shown in each cell in milliseconds.
+class ThumbnailSprite {
+  final String path;
+  final int columns;
+  final int rows;
+  final Size size;
+  final List<int> timestamps;
+  const ThumbnailSprite(
+      this.path, this.columns, this.rows, this.size, this.timestamps);
+
+  /// Get the index of the cell to show for [position] in milliseconds.
+  int indexOf(int position) {
+    var i = 0;
+    while (i + 1 < timestamps.length && timestamps[i + 1] <= position) {
+      i++;
+    }
+    return i;
+  }
+}
+
+/// This type is used by [AvMediaPlayer.snapshot] to choose the encoding of the image.
+/// [rgba] is raw pixels, 4 bytes per pixel in rows from the top.
+enum SnapshotFormat { png, jpeg, rgba }
+
+/// This type is used by [AvMediaPlayer.snapshot] to return the captured frame.
+class Snapshot {
+  final Uint8List data;
+  final int width;
+  final int height;
+  final SnapshotFormat format;
+  const Snapshot(this.data, this.width, this.height, this.format);
+}
+
+/// This type is used by [FrameTapConfig] to choose the pixel format of tapped frames.
+/// [rgba] is 4 bytes per pixel in rows from the top. [nv12] is a full size y plane followed by
+/// an interleaved uv plane of half the width and height, in bt.601 limited range.
+enum FrameFormat { rgba, nv12 }
+
+/// This type is used by [AvMediaPlayer.setFrameTap] to deliver decoded frames for analysis.
+/// At most [frameRate] frames per second are tapped, scaled down so their longest side is at most [maxSize] pixels.
+class FrameTapConfig {
+  final double frameRate;
+  final int maxSize;
+  final FrameFormat format;
+  const FrameTapConfig({
+    this.frameRate = 10,
+    this.maxSize = 640,
+    this.format = FrameFormat.rgba,
+  });
+
+  static const disabled = FrameTapConfig(frameRate: 0);
+
+  bool get enabled => frameRate > 0;
+}
+
+/// A frame delivered by the frame tap, see [AvMediaPlayer.setFrameTap].
+///
+/// The pixels stay in native memory, which is reused a few frames later
+/// but kept allocated as long as the frame or a view of its [data] is referenced.
+/// Copy what is needed right away, and check [valid] after reading [data].
+class TappedFrame {
+  /// The position of the frame in milliseconds.
+  final int pts;
+  final int width;
+  final int height;
+  final FrameFormat format;
+
+  /// Increases by 1 with each tapped frame.
+  final int sequence;
+  final Uint8List _slot;
+  TappedFrame._(this.pts, this.width, this.height, this.format, this.sequence,
+      int ring, int address, int size)
+      : _slot = Pointer<Uint8>.fromAddress(address).asTypedList(size,
+            finalizer: _release, token: Pointer<Void>.fromAddress(ring));
+
+  static final _release = DynamicLibrary.process()
+      .lookup<NativeFunction<Void Function(Pointer<Void>)>>(
+          'av_media_player_release_frame');
+
+  static void _discard(int ring) => _release
+      .asFunction<void Function(Pointer<Void>)>()(Pointer<Void>.fromAddress(ring));
+
+  /// Whether the memory still holds this frame.
+  bool get valid =>
+      ByteData.sublistView(_slot, 0, 8).getUint64(0, Endian.host) == sequence;
+
+  /// A view of the pixels in native memory.
+  Uint8List get data => Uint8List.sublistView(_slot, 32);
+}
+
+/// This type is used by [AvMediaPlayer.setAbr] to configure adaptive bit rate switching of hls streams.
+/// [safetyFactor] is the share of the estimated bandwidth a variant may take.
+/// The player switches up only when at least [upswitchBuffer] milliseconds are buffered
+/// and [switchInterval] milliseconds have passed since the last switch,
+/// and switches down as soon as the buffer would run dry within [upswitchBuffer] milliseconds.
+class AbrConfig {
+  final bool enabled;
+  final double safetyFactor;
+  final int upswitchBuffer;
+  final int switchInterval;
+  const AbrConfig({
+    this.enabled = true,
+    this.safetyFactor = 0.8,
+    this.upswitchBuffer = 10000,
+    this.switchInterval = 10000,
+  });
+
+  static const disabled = AbrConfig(enabled: false);
+}
+
+/// This type is used by [AvMediaPlayer.setLowLatency] to keep live streams close to the live edge.
+/// The player holds [targetLatency] milliseconds behind the live edge by changing the speed
+/// by at most [maxSpeedChange], and jumps forward when it falls more than [maxLatency] milliseconds behind.
+class LowLatencyConfig {
+  final bool enabled;
+  final int targetLatency;
+  final int maxLatency;
+  final double maxSpeedChange;
+  const LowLatencyConfig({
+    this.enabled = true,
+    this.targetLatency = 3000,
+    this.maxLatency = 10000,
+    this.maxSpeedChange = 0.1,
+  });
+
+  static const disabled = LowLatencyConfig(enabled: false);
+}
+
+/// This type is used by [AvMediaPlayer.setReconnect] to recover from network errors.
+/// The media is reloaded up to [maxAttempts] times, waiting [initialDelay] milliseconds before the first attempt
+/// and twice as long before each next one, but no longer than [maxDelay] milliseconds.
+class ReconnectPolicy {
+  final int maxAttempts;
+  final int initialDelay;
+  final int maxDelay;
+  const ReconnectPolicy({
+    this.maxAttempts = 5,
+    this.initialDelay = 500,
+    this.maxDelay = 8000,
+  });
+
+  static const disabled = ReconnectPolicy(maxAttempts: 0);
+}
+
+/// The statistics of the http cache, see [AvMediaPlayer.setHttpCache].
+class HttpCacheStats {
+  /// Bytes stored on disk.
+  final int size;
+  final int maxSize;
+
+  /// Bytes served from disk.
+  final int hitBytes;
+
+  /// Bytes downloaded.
+  final int missBytes;
+  final int requests;
+  final int objects;
+  const HttpCacheStats(this.size, this.maxSize, this.hitBytes, this.missBytes,
+      this.requests, this.objects);
+
+  double get hitRate => hitBytes + missBytes == 0
+      ? 0
+      : hitBytes / (hitBytes + missBytes);
+}
+
+/// A running [AvMediaPlayer.warmUp].
+class WarmUp {
+  final int _id;
+
+  /// Completes with true when all urls are done, or false if it was canceled or the http cache is disabled.
+  final Future<bool> done;
+  const WarmUp._(this._id, this.done);
+
+  /// Stop connecting and prefetching. Connections and bytes that are ready are kept.
+  void cancel() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      AvMediaPlayer._methodChannel.invokeMethod('cancelWarmUp', _id);
+    }
+  }
+}
+
+/// Native memory that can be opened as a media source, see [AvMediaPlayer.allocateMemorySource].
+class MemorySource {
+  /// Pass it to [AvMediaPlayer.open].
+  final String url;
+  final int length;
+  final int _address;
+  const MemorySource._(this.url, this.length, this._address);
+
+  /// A view of the memory. Writing to it doesn't copy anything.
+  /// It must not be used after [release].
+  Uint8List get data =>
+      Pointer<Uint8>.fromAddress(_address).asTypedList(length);
+
+  /// The memory is freed once no player reads it anymore.
+  void release() => AvMediaPlayer.releaseSource(url);
 }
 
 /// The class to create and control [AvMediaPlayer] instance.
@@ -95,6 +359,8 @@ class MediaInfo {
 class AvMediaPlayer {
   static const _methodChannel = MethodChannel('av_media_player');
   static var _detectorStarted = false;
+  static var _warmUps = 0;
+  static Stream? _probeEvents;
 
   /// Whether the player is disposed.
   var disposed = false;
@@ -139,10 +405,21 @@ class AvMediaPlayer {
   /// It's between 0.5 and 2, and defaults to 1.
   final speed = ValueNotifier(1.0);
 
+  /// The rate of keyframe only fast forward or rewind. See [setTrickPlay].
+  /// It's 0 when trick play is off, and negative while rewinding.
+  final trickPlay = ValueNotifier(0.0);
+
+  /// Whether the player is in scrub mode. See [setScrubbing].
+  final scrubbing = ValueNotifier(false);
+
   /// Whether the player should loop the media.
   /// It's false by default.
   final looping = ValueNotifier(false);
 
+  /// The A-B loop range of the current media in milliseconds.
+  /// It's null if no range is set, and will be reset to null when the media is closed.
+  final loopRange = ValueNotifier<LoopRange?>(null);
+
   /// Whether the player should play the media automatically.
   /// It's false by default.
   final autoPlay = ValueNotifier(false);
@@ -151,10 +428,39 @@ class AvMediaPlayer {
   /// It will be reset to 0 when the media is closed.
   final finishedTimes = ValueNotifier(0);
 
+  /// The memory used by the frames of the current clip in bytes.
+  /// It's 0 if the media is not played in clip mode. See [ClipOptions].
+  final clipMemory = ValueNotifier(0);
+
   /// The current buffer status of the player.
   /// It is only reported by network media.
   final bufferRange = ValueNotifier(BufferRange.empty);
 
+  /// All ranges of network media that are cached, seeking into them doesn't download again.
+  /// This is only reported on linux, and will be reset to empty when the media is closed.
+  final bufferRanges = ValueNotifier<List<BufferRange>>(const []);
+
+  /// Bytes cached ahead of the playback position. This is only reported on linux.
+  final bufferBytes = ValueNotifier(0);
+
+  /// Whether the last finished seek was served from the cache instead of the network.
+  /// It's null before the first seek, and will be reset to null when the media is closed.
+  final seekCached = ValueNotifier<bool?>(null);
+
+  /// The range of a live stream that can be paused in or seeked to, see [setTimeshift].
+  /// It's in the timestamps of the stream like [position], and null for other media.
+  /// It will be reset to null when the media is closed.
+  final timeshiftRange = ValueNotifier<BufferRange?>(null);
+
+  /// Current timeshift buffer size of the player in bytes. 0 means live streams can't be paused or rewound.
+  final timeshift = ValueNotifier(0);
+
+  /// Current reconnect policy of the player. See [setReconnect].
+  final reconnectPolicy = ValueNotifier(ReconnectPolicy.disabled);
+
+  /// The current reconnect attempt after a network error, 0 if the player is not reconnecting.
+  final reconnecting = ValueNotifier(0);
+
   /// The tracks that are overrided by the player.
   final overrideTracks = ValueNotifier<Set<String>>({});
 
@@ -164,6 +470,31 @@ class AvMediaPlayer {
   /// Current maximum resolution of the player. [Size.zero] means no limit.
   final maxResolution = ValueNotifier(Size.zero);
 
+  /// Current adaptive bit rate configuration of the player. See [setAbr].
+  final abr = ValueNotifier(AbrConfig.disabled);
+
+  /// Current low latency configuration of the player. See [setLowLatency].
+  final lowLatency = ValueNotifier(LowLatencyConfig.disabled);
+
+  /// Current frame tap configuration of the player. See [setFrameTap].
+  final frameTap = ValueNotifier(FrameTapConfig.disabled);
+
+  /// The latest frame of the frame tap. See [setFrameTap].
+  /// It will be reset to null when the media is closed.
+  final tappedFrame = ValueNotifier<TappedFrame?>(null);
+
+  /// The latency behind the live edge in milliseconds, reported while playing a live stream in low latency mode.
+  /// It will be reset to 0 when the media is closed.
+  final latency = ValueNotifier(0);
+
+  /// The estimated bandwidth in bits per second, reported while adaptive bit rate switching is active.
+  /// It will be reset to 0 when the media is closed.
+  final bandwidth = ValueNotifier(0);
+
+  /// The video track selected by adaptive bit rate switching, a key of [MediaInfo.tracks].
+  /// It will be reset to null when the media is closed.
+  final variant = ValueNotifier<String?>(null);
+
   /// The preferred audio language of the player.
   final preferredAudioLanguage = ValueNotifier<String>('');
 
@@ -174,10 +505,243 @@ class AvMediaPlayer {
   /// By default, the player does not show any subtitle. Regardless of the preferred subtitle language or override tracks.
   final showSubtitle = ValueNotifier(false);
 
+  /// Generate seek bar previews for [source] in the background.
+  ///
+  /// The nearest keyframe every [interval] milliseconds is decoded in a separate lightweight decoder,
+  /// and packed into a sprite sheet with cells no larger than [size].
+  /// The result is cached on disk, so calling it again for the same source is cheap.
+  /// This method only works on linux, and returns null on other platforms or on failure.
+  static Future<ThumbnailSprite?> generateThumbnails(
+      String source, int interval, Size size) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      try {
+        final result =
+            await _methodChannel.invokeMethod('generateThumbnails', {
+          'source': source,
+          'interval': interval,
+          'width': size.width,
+          'height': size.height,
+        }) as Map;
+        return ThumbnailSprite(
+          result['path'],
+          result['columns'],
+          result['rows'],
+          Size(result['width'].toDouble(), result['height'].toDouble()),
+          List<int>.from(result['timestamps']),
+        );
+      } on PlatformException {
+        return null;
+      }
+    }
+    return null;
+  }
+
+  /// Read the duration and tracks of [sources] without creating a player.
+  ///
+  /// Sources are probed in parallel by lightweight decoders without video or audio output,
+  /// and results are emitted as soon as each of them finishes, so they may come in any order.
+  /// The stream closes after all sources are done.
+  /// This method only works on linux, and returns an empty stream on other platforms.
+  static Stream<ProbeResult> probe(List<String> sources) {
+    if (defaultTargetPlatform != TargetPlatform.linux || sources.isEmpty) {
+      return const Stream.empty();
+    }
+    _probeEvents ??= const EventChannel('av_media_player/probe')
+        .receiveBroadcastStream()
+        .asBroadcastStream();
+    final controller = StreamController<ProbeResult>();
+    final early = <Map>[];
+    int? job;
+    late final StreamSubscription subscription;
+    void handle(Map e) {
+      if (e['event'] == 'done') {
+        subscription.cancel();
+        controller.close();
+      } else if (e['event'] == 'mediaInfo') {
+        controller.add(ProbeResult(
+          e['source'],
+          mediaInfo: MediaInfo(
+              e['duration'],
+              (e['tracks'] as Map).map(
+                  (k, v) => MapEntry(k as String, TrackInfo.fromMap(v))),
+              e['source']),
+        ));
+      } else {
+        controller.add(ProbeResult(e['source'], error: e['value']));
+      }
+    }
+
+    // results may arrive before we know the job id
+    subscription = _probeEvents!.listen((event) {
+      final e = event as Map;
+      if (job == null) {
+        early.add(e);
+      } else if (e['job'] == job) {
+        handle(e);
+      }
+    });
+    _methodChannel.invokeMethod('probe', sources).then((value) {
+      job = value;
+      for (final e in early) {
+        if (e['job'] == job) {
+          handle(e);
+        }
+      }
+      early.clear();
+    });
+    return controller.stream;
+  }
+
+  /// Cache http(s) media on disk with a local proxy, which is shared by all players.
+  ///
+  /// Sources opened afterwards are read through the proxy transparently. Byte ranges of progressive media
+  /// and segments of hls streams are kept in a least recently used cache of up to [maxSize] bytes,
+  /// so looping or revisiting them doesn't download them again. Pass 0 to stop caching new sources.
+  /// This method only works on linux, and returns false on other platforms or on failure.
+  static Future<bool> setHttpCache(int maxSize) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      return await _methodChannel.invokeMethod('setHttpCache', maxSize);
+    }
+    return false;
+  }
+
+  /// Get the statistics of the http cache.
+  /// This method only works on linux, and returns null on other platforms.
+  static Future<HttpCacheStats?> getHttpCacheStats() async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      final result =
+          await _methodChannel.invokeMethod('getHttpCacheStats') as Map;
+      return HttpCacheStats(
+        result['size'],
+        result['maxSize'],
+        result['hitBytes'],
+        result['missBytes'],
+        result['requests'],
+        result['objects'],
+      );
+    }
+    return null;
+  }
+
+  /// Prepare [urls] that are likely to be opened soon, so opening them later skips connection setup and initial buffering.
+  ///
+  /// Host names are resolved, and connections are opened and kept alive by the http cache, see [setHttpCache].
+  /// The first [prefetchBytes] bytes of progressive media, or the first [prefetchSegments] segments of hls streams
+  /// are also stored in the cache. At most [concurrency] urls are prepared at once,
+  /// and at most [maxBytes] bytes are downloaded in total.
+  /// This method only works on linux with the http cache enabled.
+  static WarmUp warmUp(
+    List<String> urls, {
+    int prefetchBytes = 0,
+    int prefetchSegments = 0,
+    int concurrency = 4,
+    int maxBytes = 32 << 20,
+  }) {
+    final id = ++_warmUps;
+    if (defaultTargetPlatform != TargetPlatform.linux || urls.isEmpty) {
+      return WarmUp._(id, Future.value(false));
+    }
+    return WarmUp._(
+      id,
+      _methodChannel.invokeMethod('warmUp', {
+        'id': id,
+        'urls': urls,
+        'prefetchBytes': prefetchBytes,
+        'prefetchSegments': prefetchSegments,
+        'concurrency': concurrency,
+        'maxBytes': maxBytes,
+      }).then((value) => value as bool),
+    );
+  }
+
+  /// Allocate [length] bytes of native memory, which players read directly from [MemorySource.url].
+  ///
+  /// Fill [MemorySource.data] before opening it, so media held in memory doesn't need a temporary file
+  /// or a copy through the platform channel. Native code can also provide sources with
+  /// `av_media_player_register_stream`, see `av_media_player_plugin.h`.
+  /// This method only works on linux, and returns null on other platforms or on failure.
+  static Future<MemorySource?> allocateMemorySource(int length) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      final result = await _methodChannel.invokeMethod(
+          'allocateMemorySource', length) as Map?;
+      if (result != null) {
+        return MemorySource._(result['url'], length, result['address']);
+      }
+    }
+    return null;
+  }
+
+  /// Register a local file encrypted with AES-CTR, and get the url to [open] it with.
+  ///
+  /// The file is decrypted on the fly while it's read, so it plays and seeks like a plain file
+  /// and the plain text never touches the disk. [key] is 16, 24 or 32 bytes, and [iv] is the 16 bytes
+  /// initial counter block, which is incremented as a 128 bit big endian integer for every 16 bytes.
+  /// Call [releaseSource] with the url once it's no longer needed.
+  /// This method only works on linux when the plugin is built with libcrypto,
+  /// and returns null on other platforms or on failure.
+  static Future<String?> addEncryptedSource(
+      String path, Uint8List key, Uint8List iv) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      return await _methodChannel.invokeMethod('addEncryptedSource', {
+        'path': path,
+        'key': key,
+        'iv': iv,
+      });
+    }
+    return null;
+  }
+
+  /// Pack the media [files] into one file at [output], so they can be opened as `pack://<name>` after [loadPack].
+  ///
+  /// [files] maps names to sources, which are local paths or `asset://` urls.
+  /// Each media is opened the way a player opens it, and its duration and tracks are stored in the pack,
+  /// so [mediaInfo] of a packed media is reported right after [open] and matches the info after loading.
+  /// It's meant to run ahead of time, for example in a debug build, with the pack then shipped as an asset.
+  /// This method only works on linux, and returns false on other platforms or on failure.
+  static Future<bool> createPack(String output, Map<String, String> files) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      return await _methodChannel.invokeMethod('createPack', {
+        'output': output,
+        'files': files,
+      });
+    }
+    return false;
+  }
+
+  /// Map a pack created by [createPack], and provide its media as `pack://<name>`.
+  ///
+  /// Opening a packed media reads it straight from the mapping, without opening any file.
+  /// [path] can be a local path or an `asset://` url. Names already provided by another pack are skipped.
+  /// Returns the number of media provided, or -1 if it's not a valid pack.
+  /// This method only works on linux, and returns -1 on other platforms.
+  static Future<int> loadPack(String path) async {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      return await _methodChannel.invokeMethod('loadPack', path);
+    }
+    return -1;
+  }
+
+  /// Stop providing the media of a pack. Players that are reading them can still finish.
+  static void unloadPack(String path) {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('unloadPack', path);
+    }
+  }
+
+  /// Release a source created by [allocateMemorySource] or [addEncryptedSource].
+  /// Players that are reading it can still finish, it's freed once they close it.
+  static void releaseSource(String url) {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('releaseSource', url);
+    }
+  }
+
   // Event channel is much more efficient than method channel
   // We'd better use it to handle playback events especially for position
   StreamSubscription? _eventSubscription;
   String? _source;
+  ClipOptions? _clip;
+  ProbeOptions? _probe;
   int? _position;
   var _seeking = false;
 
@@ -219,13 +783,20 @@ class AvMediaPlayer {
           final e = event as Map;
           if (e['event'] == 'mediaInfo') {
             if (_source == e['source']) {
-              loading.value = false;
-              playbackState.value = PlaybackState.paused;
-              mediaInfo.value = MediaInfo(
+              final info = MediaInfo(
                   e['duration'],
                   (e['tracks'] as Map).map(
                       (k, v) => MapEntry(k as String, TrackInfo.fromMap(v))),
-                  _source!);
+                  _source!,
+                  probeTime: e['probeTime']);
+              if (mediaInfo.value != null) {
+                // the cached media info was outdated, the player is already usable
+                mediaInfo.value = info;
+                return;
+              }
+              loading.value = false;
+              playbackState.value = PlaybackState.paused;
+              mediaInfo.value = info;
               if (autoPlay.value) {
                 play();
               }
@@ -252,7 +823,9 @@ class AvMediaPlayer {
                     ? PlaybackState.paused
                     : PlaybackState.closed;
           } else if (e['event'] == 'position') {
-            if (mediaInfo.value != null) {
+            if (mediaInfo.value != null && timeshiftRange.value != null) {
+              position.value = e['value'];
+            } else if (mediaInfo.value != null) {
               position.value = e['value'] > mediaInfo.value!.duration
                   ? mediaInfo.value!.duration
                   : e['value'] < 0
@@ -266,6 +839,12 @@ class AvMediaPlayer {
               bufferRange.value = begin == 0 && end == 0
                   ? BufferRange.empty
                   : BufferRange(begin, end);
+              if (e['ranges'] != null) {
+                bufferRanges.value = (e['ranges'] as List)
+                    .map((r) => BufferRange(r['begin'], r['end']))
+                    .toList();
+                bufferBytes.value = e['bytes'];
+              }
             }
           } else if (e['event'] == 'error') {
             // ignore errors when player is closed
@@ -275,6 +854,53 @@ class AvMediaPlayer {
               loading.value = false;
               _close();
             }
+          } else if (e['event'] == 'probeTime') {
+            final info = mediaInfo.value;
+            if (info != null) {
+              mediaInfo.value = MediaInfo(
+                  info.duration, info.tracks, info.source,
+                  probeTime: e['value']);
+            }
+          } else if (e['event'] == 'reconnecting') {
+            if (mediaInfo.value != null) {
+              reconnecting.value = e['attempt'];
+              loading.value = true;
+            }
+          } else if (e['event'] == 'recovered') {
+            if (mediaInfo.value != null) {
+              reconnecting.value = 0;
+              if (!_seeking) {
+                loading.value = false;
+              }
+            }
+          } else if (e['event'] == 'trickPlay') {
+            trickPlay.value = e['value'];
+          } else if (e['event'] == 'frame') {
+            if (mediaInfo.value != null) {
+              tappedFrame.value = TappedFrame._(
+                  e['pts'],
+                  e['width'],
+                  e['height'],
+                  FrameFormat.values[e['format']],
+                  e['sequence'],
+                  e['ring'],
+                  e['address'],
+                  e['size']);
+            } else {
+              TappedFrame._discard(e['ring']);
+            }
+          } else if (e['event'] == 'clipMemory') {
+            clipMemory.value = e['value'];
+          } else if (e['event'] == 'timeshift') {
+            if (mediaInfo.value != null) {
+              timeshiftRange.value = BufferRange(e['begin'], e['end']);
+            }
+          } else if (e['event'] == 'latency') {
+            latency.value = e['value'];
+          } else if (e['event'] == 'bandwidth') {
+            bandwidth.value = e['value'];
+          } else if (e['event'] == 'variantSwitch') {
+            variant.value = e['trackId'];
           } else if (e['event'] == 'loading') {
             if (mediaInfo.value != null) {
               loading.value = e['value'];
@@ -283,6 +909,9 @@ class AvMediaPlayer {
             if (mediaInfo.value != null) {
               _seeking = false;
               loading.value = false;
+              if (e['cached'] != null) {
+                seekCached.value = e['cached'];
+              }
             }
           } else if (e['event'] == 'finished') {
             if (mediaInfo.value != null) {
@@ -297,7 +926,7 @@ class AvMediaPlayer {
           }
         });
         if (_source != null) {
-          open(_source!);
+          open(_source!, clip: _clip, probe: _probe);
         }
         if (volume.value != 1) {
           _setVolume();
@@ -314,6 +943,21 @@ class AvMediaPlayer {
         if (maxResolution.value != Size.zero) {
           _setMaxResolution();
         }
+        if (abr.value.enabled) {
+          _setAbr();
+        }
+        if (lowLatency.value.enabled) {
+          _setLowLatency();
+        }
+        if (frameTap.value.enabled) {
+          _setFrameTap();
+        }
+        if (timeshift.value > 0) {
+          _setTimeshift();
+        }
+        if (reconnectPolicy.value.maxAttempts > 0) {
+          _setReconnect();
+        }
         if (preferredAudioLanguage.value.isNotEmpty) {
           _setPreferredAudioLanguage();
         }
@@ -375,13 +1019,31 @@ class AvMediaPlayer {
       playbackState.dispose();
       volume.dispose();
       speed.dispose();
+      trickPlay.dispose();
+      scrubbing.dispose();
       looping.dispose();
+      loopRange.dispose();
       autoPlay.dispose();
       finishedTimes.dispose();
       bufferRange.dispose();
+      bufferRanges.dispose();
+      bufferBytes.dispose();
+      seekCached.dispose();
+      clipMemory.dispose();
       overrideTracks.dispose();
       maxBitRate.dispose();
       maxResolution.dispose();
+      abr.dispose();
+      lowLatency.dispose();
+      frameTap.dispose();
+      tappedFrame.dispose();
+      timeshift.dispose();
+      reconnectPolicy.dispose();
+      reconnecting.dispose();
+      timeshiftRange.dispose();
+      latency.dispose();
+      bandwidth.dispose();
+      variant.dispose();
       preferredAudioLanguage.dispose();
       preferredSubtitleLanguage.dispose();
       showSubtitle.dispose();
@@ -391,15 +1053,34 @@ class AvMediaPlayer {
   /// Open a media file.
   ///
   /// [source] is the url or local path of the media file
-  void open(String source) {
+  ///
+  /// [clip] enables clip mode for short muted clips. This parameter only works on linux.
+  ///
+  /// [probe] tunes how the media is probed, see [ProbeOptions]. This parameter only works on linux.
+  void open(String source, {ClipOptions? clip, ProbeOptions? probe}) {
     if (!disposed) {
       _source = source;
+      _clip = clip;
+      _probe = probe;
       if (id.value != null) {
         error.value = null;
         _close();
         _methodChannel.invokeMethod('open', {
           'id': id.value,
           'value': source,
+          if (clip != null) ...{
+            'clipMaxDuration': clip.maxDuration,
+            'clipMaxWidth': clip.maxSize.width,
+            'clipMaxHeight': clip.maxSize.height,
+            'clipFrameWidth': clip.frameSize.width,
+            'clipFrameHeight': clip.frameSize.height,
+          },
+          if (probe != null) ...{
+            'probeSize': probe.probeSize,
+            'analyzeDuration': probe.analyzeDuration,
+            'probeInfo': probe.probeInfo,
+            if (probe.format != null) 'format': probe.format,
+          },
         });
       }
       loading.value = true;
@@ -410,6 +1091,8 @@ class AvMediaPlayer {
   void close() {
     if (!disposed) {
       _source = null;
+      _clip = null;
+      _probe = null;
       if (id.value != null &&
           (playbackState.value != PlaybackState.closed || loading.value)) {
         _methodChannel.invokeMethod('close', id.value);
@@ -470,20 +1153,54 @@ class AvMediaPlayer {
           _position = position;
           return true;
         }
-      } else if (mediaInfo.value!.duration > 0) {
-        if (position < 0) {
-          position = 0;
-        } else if (position > mediaInfo.value!.duration) {
-          position = mediaInfo.value!.duration;
+      } else if (mediaInfo.value!.duration > 0 ||
+          timeshiftRange.value != null) {
+        final range = timeshiftRange.value ??
+            BufferRange(0, mediaInfo.value!.duration);
+        if (position < range.begin) {
+          position = range.begin;
+        } else if (position > range.end) {
+          position = range.end;
         }
         _methodChannel.invokeMethod('seekTo', {
           'id': id.value,
           'value': position,
         });
+        if (!scrubbing.value) {
+          // seeks into cached ranges finish without buffering
+          if (!bufferRanges.value
+              .any((r) => r.begin <= position && r.end >= position)) {
+            loading.value = true;
+          }
+          _seeking = true;
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Enter or leave scrub mode, typically while dragging a seek bar.
+  ///
+  /// In scrub mode, [seekTo] only keeps the latest target and seeks to the nearest keyframe,
+  /// and [position] reports the frame that is actually displayed.
+  /// Leaving scrub mode performs one exact seek to the last target.
+  /// This method only works on linux.
+  bool setScrubbing(bool scrubbing) {
+    if (!disposed &&
+        defaultTargetPlatform == TargetPlatform.linux &&
+        id.value != null &&
+        scrubbing != this.scrubbing.value) {
+      this.scrubbing.value = scrubbing;
+      _methodChannel.invokeMethod('setScrubbing', {
+        'id': id.value,
+        'value': scrubbing,
+      });
+      if (!scrubbing && mediaInfo.value != null) {
         loading.value = true;
         _seeking = true;
-        return true;
       }
+      return true;
     }
     return false;
   }
@@ -507,6 +1224,81 @@ class AvMediaPlayer {
     return false;
   }
 
+  /// Fast forward or rewind at [rate] times the normal speed, for example 8 or -16. 0 turns trick play off.
+  ///
+  /// Only keyframes are decoded and no audio is played, so high rates cost about as much as normal playback.
+  /// Trick play ends at either end of the media, and when [play], [pause] or [seekTo] is called,
+  /// after which the player continues in its previous [playbackState].
+  /// It needs a media with a duration, and only works on linux.
+  bool setTrickPlay(double rate) {
+    if (!disposed &&
+        id.value != null &&
+        mediaInfo.value != null &&
+        mediaInfo.value!.duration > 0 &&
+        rate != trickPlay.value &&
+        defaultTargetPlatform == TargetPlatform.linux) {
+      trickPlay.value = rate;
+      _methodChannel.invokeMethod('setTrickPlay', {
+        'id': id.value,
+        'value': rate,
+      });
+      return true;
+    }
+    return false;
+  }
+
+  /// Pause and step one frame forward if [direction] is positive, or backward if it's negative.
+  ///
+  /// Returns the exact position of the shown frame in milliseconds, or null if no step was made.
+  /// Frames decoded while stepping are kept in memory, so after the first step backward
+  /// decoded the frames since the previous keyframe, further steps backward are instant.
+  /// It needs a media with a duration, and only works on linux.
+  Future<int?> stepFrame(int direction) async {
+    if (disposed ||
+        mediaInfo.value == null ||
+        mediaInfo.value!.duration == 0 ||
+        defaultTargetPlatform != TargetPlatform.linux) {
+      return null;
+    }
+    pause();
+    final int? pts = await _methodChannel.invokeMethod('stepFrame', {
+      'id': id.value,
+      'value': direction < 0 ? -1 : 1,
+    });
+    if (pts != null && !disposed && mediaInfo.value != null) {
+      position.value = pts;
+    }
+    return pts;
+  }
+
+  /// Capture the frame that is currently shown.
+  ///
+  /// The frame is scaled down so its longest side is at most [maxSize] pixels, 0 keeps the video size.
+  /// It's read back from the gpu without stalling playback, and encoded in the background.
+  /// Returns null if no frame is shown or on failure, which includes a player that is not on screen
+  /// and so doesn't render the frame within a second.
+  /// This method only works on linux, and returns null on other platforms.
+  Future<Snapshot?> snapshot(
+      {SnapshotFormat format = SnapshotFormat.png, int maxSize = 0}) async {
+    if (disposed ||
+        id.value == null ||
+        defaultTargetPlatform != TargetPlatform.linux) {
+      return null;
+    }
+    try {
+      final result = await _methodChannel.invokeMethod('snapshot', {
+        'id': id.value,
+        'format': format.index,
+        'maxSize': maxSize,
+      });
+      return result == null
+          ? null
+          : Snapshot(result['data'], result['width'], result['height'], format);
+    } on PlatformException {
+      return null;
+    }
+  }
+
   /// Set playback speed of the player.
   ///
   /// [speed] is the speed to set between 0.5 and 2.
@@ -540,6 +1332,35 @@ class AvMediaPlayer {
     return false;
   }
 
+  /// Set the A-B loop range of the current media.
+  /// Playback between [LoopRange.begin] and [LoopRange.end] repeats until the range is cleared by passing null.
+  /// This method only works on linux.
+  bool setLoopRange(LoopRange? range) {
+    if (!disposed &&
+        defaultTargetPlatform == TargetPlatform.linux &&
+        mediaInfo.value != null &&
+        mediaInfo.value!.duration > 0) {
+      if (range != null) {
+        final begin = range.begin < 0 ? 0 : range.begin;
+        final end = range.end > mediaInfo.value!.duration
+            ? mediaInfo.value!.duration
+            : range.end;
+        range = end > begin ? LoopRange(begin, end) : null;
+      }
+      if (range?.begin != loopRange.value?.begin ||
+          range?.end != loopRange.value?.end) {
+        loopRange.value = range;
+        _methodChannel.invokeMethod('setLoopRange', {
+          'id': id.value,
+          'begin': range?.begin ?? 0,
+          'end': range?.end ?? 0,
+        });
+        return true;
+      }
+    }
+    return false;
+  }
+
   /// Set whether the player should play the media automatically.
   bool setAutoPlay(bool autoPlay) {
     if (!disposed && autoPlay != this.autoPlay.value) {
@@ -579,6 +1400,120 @@ class AvMediaPlayer {
     return false;
   }
 
+  /// Let the player pick the variant of hls streams from its own bandwidth estimate.
+  ///
+  /// The bandwidth is measured from the download rate while the buffer is filling,
+  /// and the variant with the highest bit rate that fits is picked within [maxBitRate] and [maxResolution].
+  /// Overriding the video track with [overrideTrack] pauses it. It's disabled by default.
+  /// This method only works on linux.
+  bool setAbr(AbrConfig config) {
+    if (!disposed) {
+      abr.value = config;
+      if (id.value != null) {
+        _setAbr();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /// Reload network media automatically after a network error, see [ReconnectPolicy].
+  ///
+  /// The media resumes at the same position with the same tracks, and [mediaInfo] is kept.
+  /// [reconnecting] shows the current attempt, and [error] is only set once all attempts failed.
+  /// It's disabled by default. This method only works on linux.
+  bool setReconnect(ReconnectPolicy policy) {
+    if (!disposed) {
+      reconnectPolicy.value = policy;
+      if (id.value != null) {
+        _setReconnect();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /// Keep up to [maxBytes] bytes of live streams on disk behind the playback position,
+  /// so they can be paused and rewound within [timeshiftRange] without downloading again.
+  /// Pass 0 to disable it, which is the default. It applies from the next [open].
+  /// This method only works on linux.
+  bool setTimeshift(int maxBytes) {
+    if (!disposed && maxBytes >= 0 && maxBytes != timeshift.value) {
+      timeshift.value = maxBytes;
+      if (id.value != null) {
+        _setTimeshift();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /// Keep live streams close to the live edge, see [LowLatencyConfig].
+  ///
+  /// The player also starts live hls streams from the newest segment and resumes from stalls sooner,
+  /// which applies from the next [open]. The speed change is applied on top of [speed]. It's disabled by default.
+  /// This method only works on linux.
+  bool setLowLatency(LowLatencyConfig config) {
+    if (!disposed) {
+      lowLatency.value = config;
+      if (id.value != null) {
+        _setLowLatency();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /// Create an additional texture that shows the video of this player, e.g. for a thumbnail or a second window.
+  ///
+  /// The frames are decoded once and scaled down on the gpu to fit in [maxWidth] x [maxHeight], 0 means no limit.
+  /// Show it with [AvMediaView.mirrorId], and remove it with [removeMirror] once it's no longer needed.
+  /// Mirrors are removed when the player is disposed.
+  /// Returns the texture id, or null on other platforms than linux.
+  Future<int?> addMirror({int maxWidth = 0, int maxHeight = 0}) async {
+    if (disposed ||
+        id.value == null ||
+        defaultTargetPlatform != TargetPlatform.linux) {
+      return null;
+    }
+    return await _methodChannel.invokeMethod('addMirror', {
+      'id': id.value,
+      'maxWidth': maxWidth,
+      'maxHeight': maxHeight,
+    });
+  }
+
+  /// Remove a texture created by [addMirror].
+  void removeMirror(int textureId) {
+    if (!disposed &&
+        id.value != null &&
+        defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('removeMirror', {
+        'id': id.value,
+        'value': textureId,
+      });
+    }
+  }
+
+  /// Deliver decoded frames at a fixed rate and size for analysis, see [FrameTapConfig].
+  ///
+  /// Frames are taken from the gpu without stalling playback and converted in the background.
+  /// They are reported by [tappedFrame], and native code can receive them with `av_media_player_set_frame_callback`.
+  /// Frames are taken from the rendered video, so they are only tapped while the player is on screen,
+  /// directly, through a mirror or on a video wall.
+  /// It's disabled by default.
+  /// This method only works on linux.
+  bool setFrameTap(FrameTapConfig config) {
+    if (!disposed) {
+      frameTap.value = config;
+      if (id.value != null) {
+        _setFrameTap();
+      }
+      return true;
+    }
+    return false;
+  }
+
   /// Set the preferred audio language of the player.
   /// An empty string means using the system default.
   bool setPreferredAudioLanguage(String language) {
@@ -648,6 +1583,39 @@ class AvMediaPlayer {
     return false;
   }
 
+  /// Add an external srt, ass/ssa or webvtt subtitle file to the current media.
+  ///
+  /// The file is parsed in the background, so large files don't block playback.
+  /// [source] can be a local path, a `file://` or an `asset://` url. [language] is reported in [TrackInfo.language].
+  /// Returns the id of the new track in [MediaInfo.tracks], which can be passed to [overrideTrack],
+  /// or null if the file can't be parsed or another media was opened meanwhile.
+  /// Subtitles from files are drawn as plain text, and are dropped when the media is closed.
+  /// This method only works on linux, and returns null on other platforms.
+  Future<String?> addSubtitle(String source, [String? language]) async {
+    if (disposed ||
+        mediaInfo.value == null ||
+        defaultTargetPlatform != TargetPlatform.linux) {
+      return null;
+    }
+    final media = _source;
+    final result = await _methodChannel.invokeMethod('addSubtitle', {
+      'id': id.value,
+      'source': source,
+      'language': language ?? '',
+    });
+    final info = mediaInfo.value;
+    if (result == null || disposed || info == null || _source != media) {
+      return null;
+    }
+    final trackId = result['trackId'] as String;
+    mediaInfo.value = MediaInfo(
+        info.duration,
+        {...info.tracks, trackId: TrackInfo.fromMap(result['track'])},
+        info.source,
+        probeTime: info.probeTime);
+    return trackId;
+  }
+
   void _setMaxResolution() => _methodChannel.invokeMethod('setMaxResolution', {
         'id': id.value,
         'width': maxResolution.value.width,
@@ -659,6 +1627,61 @@ class AvMediaPlayer {
         'value': maxBitRate.value,
       });
 
+  void _setAbr() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('setAbr', {
+        'id': id.value,
+        'enabled': abr.value.enabled,
+        'safetyFactor': abr.value.safetyFactor,
+        'upswitchBuffer': abr.value.upswitchBuffer,
+        'switchInterval': abr.value.switchInterval,
+      });
+    }
+  }
+
+  void _setReconnect() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('setReconnect', {
+        'id': id.value,
+        'maxAttempts': reconnectPolicy.value.maxAttempts,
+        'initialDelay': reconnectPolicy.value.initialDelay,
+        'maxDelay': reconnectPolicy.value.maxDelay,
+      });
+    }
+  }
+
+  void _setTimeshift() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('setTimeshift', {
+        'id': id.value,
+        'value': timeshift.value,
+      });
+    }
+  }
+
+  void _setLowLatency() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('setLowLatency', {
+        'id': id.value,
+        'targetLatency':
+            lowLatency.value.enabled ? lowLatency.value.targetLatency : 0,
+        'maxLatency': lowLatency.value.maxLatency,
+        'maxSpeedChange': lowLatency.value.maxSpeedChange,
+      });
+    }
+  }
+
+  void _setFrameTap() {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      _methodChannel.invokeMethod('setFrameTap', {
+        'id': id.value,
+        'frameRate': frameTap.value.frameRate,
+        'maxSize': frameTap.value.maxSize,
+        'format': frameTap.value.format.index,
+      });
+    }
+  }
+
   void _setVolume() => _methodChannel.invokeMethod('setVolume', {
         'id': id.value,
         'value': volume.value,
@@ -696,8 +1719,169 @@ class AvMediaPlayer {
     videoSize.value = Size.zero;
     position.value = 0;
     bufferRange.value = BufferRange.empty;
+    bufferRanges.value = const [];
+    bufferBytes.value = 0;
+    seekCached.value = null;
     finishedTimes.value = 0;
+    loopRange.value = null;
+    clipMemory.value = 0;
+    bandwidth.value = 0;
+    variant.value = null;
+    latency.value = 0;
+    timeshiftRange.value = null;
+    reconnecting.value = 0;
+    trickPlay.value = 0;
+    tappedFrame.value = null;
     playbackState.value = PlaybackState.closed;
     overrideTracks.value = {};
   }
 }
+
+/// A video wall, which draws the videos of many players into the tiles of one texture.
+///
+/// Flutter composites a single texture and gets a single frame available signal per vsync,
+/// no matter how many tiles there are. Show it with `Texture(textureId: wall.id.value!)`
+/// in a box with the aspect ratio of [size].
+/// This class only works on linux.
+class AvMediaWall {
+  final int columns;
+  final int rows;
+
+  /// The size of each tile in pixels of the texture.
+  final Size tileSize;
+
+  /// The id of the texture.
+  /// It never changes after the wall is created, or it's null before that.
+  final id = ValueNotifier<int?>(null);
+
+  /// Whether the wall is disposed.
+  var disposed = false;
+
+  final List<AvMediaPlayer?> _tiles;
+
+  /// Create a wall of [columns] x [rows] tiles.
+  AvMediaWall({
+    required this.columns,
+    required this.rows,
+    this.tileSize = const Size(320, 180),
+  }) : _tiles = List.filled(columns * rows, null) {
+    if (defaultTargetPlatform == TargetPlatform.linux) {
+      AvMediaPlayer._methodChannel.invokeMethod('createWall', {
+        'columns': columns,
+        'rows': rows,
+        'tileWidth': tileSize.width.toInt(),
+        'tileHeight': tileSize.height.toInt(),
+      }).then((value) {
+        if (disposed) {
+          AvMediaPlayer._methodChannel.invokeMethod('disposeWall', value);
+        } else {
+          id.value = value;
+          for (var i = 0; i < _tiles.length; i++) {
+            if (_tiles[i] != null) {
+              _setTile(i);
+            }
+          }
+        }
+      });
+    }
+  }
+
+  /// The size of the texture in pixels.
+  Size get size => Size(columns * tileSize.width, rows * tileSize.height);
+
+  /// The player shown in a tile, tiles are numbered row by row from the top left.
+  AvMediaPlayer? operator [](int index) => _tiles[index];
+
+  /// The area of a tile in pixels of the texture.
+  Rect tileRect(int index) => Rect.fromLTWH(
+        (index % columns) * tileSize.width,
+        (index ~/ columns) * tileSize.height,
+        tileSize.width,
+        tileSize.height,
+      );
+
+  /// The area of the video in a tile in pixels of the texture, which keeps the aspect ratio of the video.
+  /// It's empty if the tile shows nothing.
+  Rect videoRect(int index) {
+    final player = _tiles[index];
+    final tile = tileRect(index);
+    if (player == null || player.disposed || player.videoSize.value.isEmpty) {
+      return Rect.fromCenter(center: tile.center, width: 0, height: 0);
+    }
+    final video = player.videoSize.value;
+    final scale = tile.width / video.width < tile.height / video.height
+        ? tile.width / video.width
+        : tile.height / video.height;
+    return Rect.fromCenter(
+      center: tile.center,
+      width: video.width * scale,
+      height: video.height * scale,
+    );
+  }
+
+  /// The index of the tile at [position] in pixels of the texture, or null if it's outside of the wall.
+  int? tileAt(Offset position) {
+    final column = position.dx ~/ tileSize.width;
+    final row = position.dy ~/ tileSize.height;
+    return position.dx < 0 ||
+            position.dy < 0 ||
+            column >= columns ||
+            row >= rows
+        ? null
+        : row * columns + column;
+  }
+
+  /// Show [player] in a tile, or clear the tile if [player] is null.
+  ///
+  /// A player is shown in one tile of one wall at most, so it leaves its previous tile.
+  /// While it's on a wall, it's not drawn into its own texture, but mirrors of it still work.
+  bool setTile(int index, AvMediaPlayer? player) {
+    if (disposed || index < 0 || index >= _tiles.length) {
+      return false;
+    }
+    if (player != null) {
+      for (var i = 0; i < _tiles.length; i++) {
+        if (_tiles[i] == player) {
+          _tiles[i] = null;
+        }
+      }
+    }
+    _tiles[index] = player;
+    if (id.value != null) {
+      _setTile(index);
+    }
+    return true;
+  }
+
+  /// Dispose the wall. Its players are drawn into their own textures again.
+  void dispose() {
+    if (!disposed) {
+      disposed = true;
+      if (id.value != null) {
+        AvMediaPlayer._methodChannel.invokeMethod('disposeWall', id.value);
+      }
+      id.dispose();
+    }
+  }
+
+  void _setTile(int index) {
+    final player = _tiles[index];
+    if (player != null && player.id.value == null) {
+      // the player is not created yet
+      void listener() {
+        player.id.removeListener(listener);
+        if (!disposed && _tiles[index] == player) {
+          _setTile(index);
+        }
+      }
+
+      player.id.addListener(listener);
+      return;
+    }
+    AvMediaPlayer._methodChannel.invokeMethod('setWallTile', {
+      'id': id.value,
+      'index': index,
+      'player': player?.id.value,
+    });
+  }
+}
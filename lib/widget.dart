@@ -22,6 +22,7 @@ class AvMediaView extends StatefulWidget {
   final String? initPreferredAudioLanguage;
   final int? initMaxBitRate;
   final Size? initMaxResolution;
+  final int? mirrorId;
 
   /// Create a new [AvMediaView] widget.
   /// If [initPlayer] is null, a new player will be created.
@@ -33,6 +34,9 @@ class AvMediaView extends StatefulWidget {
   /// [sizingMode] indicates how to size the video.
   /// This parameter can be changed by updating the widget.
   ///
+  /// [mirrorId] is a texture created by [AvMediaPlayer.addMirror] of [initPlayer],
+  /// which is shown instead of the main texture of the player.
+  ///
   /// Other parameters only take efferts at the time the widget is mounted.
   /// To changed them later, you need to call the corresponding methods of the player.
   const AvMediaView({
@@ -49,6 +53,7 @@ class AvMediaView extends StatefulWidget {
     this.initPreferredAudioLanguage,
     this.initMaxBitRate,
     this.initMaxResolution,
+    this.mirrorId,
     this.onCreated,
     this.backgroundColor,
     this.sizingMode = SizingMode.keepAspectRatio,
@@ -148,16 +153,17 @@ class _AVMediaState extends State<AvMediaView> with SetStateAsync {
   @override
   Widget build(BuildContext context) {
     if (_player!.videoSize.value != Size.zero) {
+      final textureId = widget.mirrorId ?? _player!.id.value!;
       final texture = _player!.subId != null && _player!.showSubtitle.value
           ? Stack(
               textDirection: TextDirection.ltr,
               fit: StackFit.passthrough,
               children: [
-                Texture(textureId: _player!.id.value!),
+                Texture(textureId: textureId),
                 Texture(textureId: _player!.subId!),
               ],
             )
-          : Texture(textureId: _player!.id.value!);
+          : Texture(textureId: textureId);
       if (widget.sizingMode == SizingMode.keepAspectRatio) {
         return AspectRatio(
           aspectRatio:
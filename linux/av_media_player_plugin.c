@@ -1,4 +1,7 @@
 #include "include/av_media_player/av_media_player_plugin.h"
+#include "av_media_player_proxy.h"
+#include "av_media_player_stream.h"
+#include "av_media_player_tap.h"
 #include <flutter_linux/flutter_linux.h>
 #include <locale.h>
 #include <gdk/gdkx.h>
@@ -8,6 +11,120 @@
 #include <mpv/client.h>
 #include <mpv/render_gl.h>
 #include <unicode/uloc.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <pango/pangocairo.h>
+#include <glib/gstdio.h>
+
+/* subtitle overlay class, mpv renders the video without text subtitles and the current cue is drawn into its own texture */
+#define AV_MEDIA_PLAYER_SUBTITLE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), av_media_player_subtitle_get_type(), AvMediaPlayerSubtitle))
+typedef struct {
+	FlTextureGL parent_instance;
+	GMutex mutex;   // guards pixels, which are uploaded in the render thread
+	guint8* pixels; // premultiplied rgba, a single transparent pixel if there's nothing to show
+	GLsizei width;
+	GLsizei height;
+	bool dirty;     // pixels have not been uploaded yet
+	GLuint texture;
+} AvMediaPlayerSubtitle;
+typedef struct {
+	FlTextureGLClass parent_class;
+} AvMediaPlayerSubtitleClass;
+G_DEFINE_TYPE(AvMediaPlayerSubtitle, av_media_player_subtitle, fl_texture_gl_get_type())
+
+static gboolean av_media_player_subtitle_populate(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
+	AvMediaPlayerSubtitle* self = AV_MEDIA_PLAYER_SUBTITLE(texture);
+	g_mutex_lock(&self->mutex);
+	if (self->texture == 0) {
+		glGenTextures(1, &self->texture);
+		glBindTexture(GL_TEXTURE_2D, self->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		self->dirty = true;
+	}
+	if (self->dirty) {
+		self->dirty = false;
+		glBindTexture(GL_TEXTURE_2D, self->texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, self->width, self->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, self->pixels);
+	}
+	*target = GL_TEXTURE_2D;
+	*name = self->texture;
+	*width = self->width;
+	*height = self->height;
+	g_mutex_unlock(&self->mutex);
+	return TRUE;
+}
+
+static void av_media_player_subtitle_dispose(GObject* obj) {
+	AvMediaPlayerSubtitle* self = AV_MEDIA_PLAYER_SUBTITLE(obj);
+	if (self->texture) {
+		glDeleteTextures(1, &self->texture);
+		self->texture = 0;
+	}
+	g_free(self->pixels);
+	self->pixels = NULL;
+	G_OBJECT_CLASS(av_media_player_subtitle_parent_class)->dispose(obj);
+}
+
+static void av_media_player_subtitle_finalize(GObject* obj) {
+	g_mutex_clear(&AV_MEDIA_PLAYER_SUBTITLE(obj)->mutex);
+	G_OBJECT_CLASS(av_media_player_subtitle_parent_class)->finalize(obj);
+}
+
+static void av_media_player_subtitle_class_init(AvMediaPlayerSubtitleClass* klass) {
+	FL_TEXTURE_GL_CLASS(klass)->populate = av_media_player_subtitle_populate;
+	G_OBJECT_CLASS(klass)->dispose = av_media_player_subtitle_dispose;
+	G_OBJECT_CLASS(klass)->finalize = av_media_player_subtitle_finalize;
+}
+
+static void av_media_player_subtitle_init(AvMediaPlayerSubtitle* self) {
+	g_mutex_init(&self->mutex);
+	self->pixels = g_malloc0(4);
+	self->width = 1;
+	self->height = 1;
+	self->dirty = true;
+	self->texture = 0;
+}
+
+/* video wall class, the frames of many players are drawn into the tiles of one atlas texture, see the video wall section */
+#define AV_MEDIA_PLAYER_WALL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), av_media_player_wall_get_type(), AvMediaPlayerWall))
+typedef struct {
+	FlTextureGL parent_instance;
+	FlTextureRegistrar* textureRegistrar;
+	GMutex mutex;       // guards tiles and serials, which are drawn in the render thread
+	gpointer* tiles;    // the AvMediaPlayer of each tile from the top left, row by row, or NULL
+	guint* serials;     // shownSerial of the player when its tile was drawn
+	uint16_t columns;
+	uint16_t rows;
+	uint16_t tileWidth;
+	uint16_t tileHeight;
+	gint pending;       // the wall is marked and has not been populated since, so frames of players are coalesced
+	bool clear;         // tiles were removed, so the atlas is cleared and all tiles are drawn again
+	GLuint source;      // framebuffer to read the frames of players
+	GLuint texture;
+	GLuint fbo;
+} AvMediaPlayerWall;
+typedef struct {
+	FlTextureGLClass parent_class;
+} AvMediaPlayerWallClass;
+G_DEFINE_TYPE(AvMediaPlayerWall, av_media_player_wall, fl_texture_gl_get_type())
+
+/* external subtitle files, see the external subtitles section */
+typedef struct {
+	int64_t start; // in milliseconds
+	int64_t end;
+	int64_t reach; // latest end of this and all previous cues, so overlapping cues are found without a full scan
+	const gchar* text;
+} AvMediaPlayerCue;
+typedef struct {
+	uint16_t id;
+	gchar* language;
+	const gchar* format;
+	GArray* cues;        // see AvMediaPlayerCue, sorted by start
+	GStringChunk* texts; // owns the text of all cues
+} AvMediaPlayerSubtitleFile;
 
 /* player class */
 #define AV_MEDIA_PLAYER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), av_media_player_get_type(), AvMediaPlayer))
@@ -22,22 +139,129 @@ typedef struct {
 	int64_t id;
 	int64_t position;
 	int64_t bufferPosition;
+	GArray* cacheRanges; // seekable ranges of the demuxer cache, pairs of begin and end in milliseconds
+	bool seekCached;     // the current seek lands in a cached range
 	double speed;
 	double volume;
-	GArray* videoTracks; // video tracks with id, width, height
+	GArray* videoTracks; // see AvMediaPlayerVideoTrack
+	GArray* clipFrames; // frames captured in clip mode, see AvMediaPlayerClipFrame
+	GMutex clipMutex;    // guards clipFrames, clipState, the clip clock, stepFrames, snapshots, tap and framePts, which are used in the render thread
+	int64_t framePts;       // time-pos of the frame mpv shows in milliseconds, -1 if unknown, published by the main thread
+	bool framePtsMissed;    // a new frame was rendered before its framePts was published, so it has to be captured again
+	int64_t renderedPts;    // framePts when mpv rendered last time, render thread only
+	int64_t clipDuration;
+	int64_t clipClock;      // clip position in milliseconds when clipClockTime was taken
+	int64_t clipClockTime;  // monotonic time in microseconds
+	int64_t clipMemory;     // bytes used by clipFrames
+	int64_t clipMaxDuration; // 0 to disable clip mode
+	int64_t clipInterval;   // frame duration of the clip in milliseconds
+	int64_t clipLast;       // pts of the frame captured last in the current pass, only used in the render thread
+	guint clipPasses;       // passes captured so far, only used in the render thread
+	guint clipTimer;
+	GLuint clipFbo;         // draw target of the capture, only used in the render thread
+	GArray* staleTextures;  // textures released in the main thread, deleted in the render thread, guarded by clipMutex
+	GArray* stepFrames;     // decoded frames around the position while frame stepping, see AvMediaPlayerClipFrame, sorted by pts
+	int64_t stepMemory;     // bytes used by stepFrames
+	int64_t stepLast;       // pts of the latest frame rendered while stepping
+	int64_t stepTarget;     // pts of the frame a backward step started from
+	int stepIndex;          // cached frame shown instead of the output of mpv, -1 for none
+	uint8_t stepState;      // 0: idle, 1: stepping forward, 2: decoding the frames before stepTarget, 3: caching the frame at stepTarget
+	FlMethodCall* stepCall; // pending stepFrame call
+	GPtrArray* snapshots;   // snapshots waiting for the render thread, see AvMediaPlayerSnapshotJob
+	guint snapshotTimer;    // keeps the render thread polling while snapshots or tapped frames are read back
+	AvMediaPlayerTap* tap;  // NULL if the frame tap is off
+	GPtrArray* staleTaps;   // taps replaced in the main thread, freed in the render thread, guarded by clipMutex
+	bool tapPending;        // the tap has frames being read back
+	GPtrArray* mirrors;     // see AvMediaPlayerMirror
+	GMutex mirrorMutex;     // guards mirrors and wall, which are marked from the render thread and the mpv thread
+	AvMediaPlayerWall* wall; // the wall the player is drawn on instead of its own texture, NULL if none
+	gint wallDirty;         // the player was marked since the wall drew it last time
+	gint frameCount;        // increased for each new frame of mpv
+	gint renderedCount;     // frameCount when mpv rendered last time, render thread only
+	GLuint shownTexture;    // the texture returned by the last populate, render thread only
+	GLsizei shownWidth;
+	GLsizei shownHeight;
+	guint shownSerial;      // increased each time shownTexture is returned
 	GLuint texture;
 	GLsizei width;
 	GLsizei height;
+	AvMediaPlayerSubtitle* subtitle;
+	gchar* subText;    // current cue as plain text, NULL if there's none
+	bool showSubtitle;
+	bool subOverlay;   // the selected subtitle is plain text and drawn into the overlay, otherwise mpv renders it into the video
+	GPtrArray* subtitleFiles;             // external subtitles of the current media
+	GPtrArray* subtitleJobs;              // parsed subtitles waiting for the media to be loaded, see AvMediaPlayerSubtitleJob
+	AvMediaPlayerSubtitleFile* subtitleFile; // selected external subtitle, it replaces sub-text of mpv
+	int64_t cueFrom;  // subText stays valid from cueFrom until cueUntil
+	int64_t cueUntil;
 	uint16_t overrideVideo; // 0 for auto otherwise track id
 	uint16_t overrideAudio;
 	uint16_t overrideSubtitle;
 	uint16_t maxWidth; // 0 for auto
 	uint16_t maxHeight;
+	uint32_t maxBitRate; // 0 for auto
+	guint abrTimer;
+	double abrFast;         // bandwidth estimates in bits per second, with a short and a long half life
+	double abrSlow;
+	double abrSafety;       // share of the estimated bandwidth a variant may take
+	int64_t abrUpBuffer;    // buffered milliseconds needed to switch up, switching down happens when the buffer would run dry sooner
+	int64_t abrInterval;    // minimum milliseconds between two switches up
+	int64_t abrSwitchTime;  // monotonic time of the last switch in microseconds
+	uint16_t abrTrack;      // video track selected by abr, 0 for none
+	bool abr;
+	int64_t liveTarget;     // target latency behind the live edge in milliseconds, 0 disables low latency mode
+	int64_t liveMaxLatency; // jump to the live edge beyond this latency
+	double liveMaxRate;     // maximum change of the speed while catching up, 0.1 means 0.9x to 1.1x
+	double liveRate;        // current catch up factor, applied on top of speed
+	guint liveTimer;
+	int64_t timeshift;      // bytes of a live stream kept on disk behind the playback position, 0 disables timeshift
+	bool timeshifted;       // the user paused or seeked a live stream, so it's intentionally behind the live edge
+	double trickRate;       // rate of keyframe only fast forward or rewind, negative for rewind, 0 when off
+	int64_t trickBase;      // trick play position in milliseconds when trickBaseTime was taken
+	int64_t trickBaseTime;  // monotonic time in microseconds
+	guint trickTimer;
+	int64_t openTime;         // monotonic time of the last loadfile in microseconds
+	int reconnectMax;         // attempts to reload the media after a network error, 0 disables reconnecting
+	int64_t reconnectDelay;   // delay before the first attempt in milliseconds, doubled after each failed attempt
+	int64_t reconnectMaxDelay;
+	int reconnectAttempts;
+	guint reconnectTimer;
+	bool reconnecting;
+	uint16_t clipMaxWidth;
+	uint16_t clipMaxHeight;
+	uint16_t clipFrameWidth;  // captured frames are scaled down to fit in this size, 0 to keep the video size
+	uint16_t clipFrameHeight;
+	uint16_t clipWidth;       // size of the captured frames, only used in the render thread
+	uint16_t clipHeight;
+	gchar* infoIdentity; // media info cache key of the current source, NULL if it can't be cached
+	FlValue* cachedInfo;  // media info reported from the cache, NULL if there was no entry
+	int64_t pendingSeek;  // seek requested before the media is loaded, -1 for none
+	bool pendingPlay;     // play requested before the media is loaded
+	FlMethodCall* pendingStepCall; // stepFrame requested before the media is loaded
+	int8_t pendingStep;   // direction of pendingStepCall
+	int64_t loopBegin; // a-b loop range in milliseconds, 0 for none
+	int64_t loopEnd;
+	int64_t scrubTarget; // latest seek target while scrubbing, -1 for none
 	bool looping;
+	bool seeking; // a seek issued by us is in progress
+	int64_t wrapFrom; // position when mpv started a seek of its own, -1 if there's none
+	bool scrubbing;
+	bool scrubPending; // scrubTarget has not been sent to mpv yet
 	bool streaming;
 	bool networking;
 	uint8_t state; // 0: idle, 1: opening, 2: paused, 3: playing
+	uint8_t clipState; // 0: off, 1: capturing, 2: playing from memory; written in the main thread under clipMutex
 } AvMediaPlayer;
+typedef struct {
+	GLuint texture;
+	int64_t pts; // in milliseconds
+} AvMediaPlayerClipFrame;
+typedef struct {
+	uint16_t id;
+	uint16_t width;
+	uint16_t height;
+	int64_t bitrate; // 0 if unknown
+} AvMediaPlayerVideoTrack;
 typedef struct {
 	FlTextureGLClass parent_class;
 } AvMediaPlayerClass;
@@ -53,6 +277,20 @@ typedef struct {
 	FlMethodChannel* methodChannel;
 	GTree* players; // all write operations on the tree are done in the main thread
 	GMutex mutex;   // so we just need to lock the mutex when reading in other threads
+	GThreadPool* thumbnailPool; // created on first use
+	gint thumbnailCancelled;    // set on dispose, the queued thumbnail jobs are answered with an error
+	GThreadPool* probePool;     // created on first use
+	gint probeCancelled;        // set on dispose, the probes still running or queued drop their results
+	GAsyncQueue* probeHandles;  // idle mpv handles for probing
+	FlEventChannel* probeChannel;
+	int64_t probeJobs;
+	double bandwidth; // latest bandwidth estimate of all players, new players start from it
+	GThreadPool* infoPool; // writes media info cache entries, created on first use
+	GThreadPool* subtitlePool; // parses external subtitles, created on first use
+	gint subtitleCancelled;    // set on dispose, the queued subtitle jobs are answered with null
+	GThreadPool* snapshotPool; // encodes snapshots, created on first use
+	GHashTable* warmUps;   // running warm up ids to GCancellable
+	GHashTable* walls;     // texture ids to AvMediaPlayerWall
 } AvMediaPlayerPlugin;
 typedef struct {
 	GObjectClass parent_class;
@@ -61,6 +299,20 @@ G_DEFINE_TYPE(AvMediaPlayerPlugin, av_media_player_plugin, g_object_get_type())
 
 static AvMediaPlayerPlugin* plugin;
 
+static void av_media_player_mark(AvMediaPlayer* self) {
+	g_mutex_lock(&self->mirrorMutex);
+	AvMediaPlayerWall* wall = self->wall;
+	if (wall) {
+		g_atomic_int_set(&self->wallDirty, 1);
+		if (g_atomic_int_compare_and_exchange(&wall->pending, 0, 1)) {
+			fl_texture_registrar_mark_texture_frame_available(wall->textureRegistrar, FL_TEXTURE(wall));
+		}
+	} else {
+		fl_texture_registrar_mark_texture_frame_available(self->textureRegistrar, FL_TEXTURE(self));
+	}
+	g_mutex_unlock(&self->mirrorMutex);
+}
+
 static gint compare_key(gconstpointer a, gconstpointer b) {
 	int64_t i = (int64_t)a;
 	int64_t j = (int64_t)b;
@@ -78,6 +330,198 @@ static gboolean release_object_on_tree(gpointer key, gpointer value, gpointer ob
 	return FALSE;
 }
 
+static gchar* resolve_source(const gchar* source) {
+	if (g_str_has_prefix(source, "asset://")) {
+		g_autoptr(FlDartProject) project = fl_dart_project_new();
+		return g_strdup_printf("%s%s", fl_dart_project_get_assets_path(project), &source[7]);
+	} else {
+		return g_strdup(source);
+	}
+}
+
+static FlValue* read_tracks(mpv_handle* mpv, GArray* videoTracks) {
+	// videoTracks can be NULL if the caller doesn't need them
+	int64_t count;
+	mpv_get_property(mpv, "track-list/count", MPV_FORMAT_INT64, &count);
+	FlValue* tracks = fl_value_new_map();
+	for (uint i = 0; i < count; i++) {
+		FlValue* info = fl_value_new_map();
+		gchar* str;
+		gchar p[33];
+		sprintf(p, "track-list/%d/type", i);
+		mpv_get_property(mpv, p, MPV_FORMAT_STRING, &str);
+		fl_value_set_string_take(info, "type", fl_value_new_string(str));
+		uint8_t type = g_str_equal(str, "video") ? 0 : g_str_equal(str, "audio") ? 1 : 2;
+		mpv_free(str);
+		int64_t trackId;
+		sprintf(p, "track-list/%d/id", i);
+		mpv_get_property(mpv, p, MPV_FORMAT_INT64, &trackId);
+		int64_t size;
+		sprintf(p, "track-list/%d/lang", i);
+		if (!mpv_get_property(mpv, p, MPV_FORMAT_STRING, &str)) {
+			UErrorCode status = U_ZERO_ERROR;
+			char langtag[ULOC_FULLNAME_CAPACITY];
+			uloc_toLanguageTag(str, langtag, ULOC_FULLNAME_CAPACITY, FALSE, &status); // we don't want ISO 639-2 codes
+			fl_value_set_string_take(info, "language", fl_value_new_string(U_FAILURE(status) ? str : langtag));
+			mpv_free(str);
+		}
+		sprintf(p, "track-list/%d/title", i);
+		if (!mpv_get_property(mpv, p, MPV_FORMAT_STRING, &str)) {
+			fl_value_set_string_take(info, "label", fl_value_new_string(str));
+			mpv_free(str);
+		}
+		int64_t bitrate = 0;
+		sprintf(p, "track-list/%d/hls-bitrate", i);
+		if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &bitrate)) {
+			fl_value_set_string_take(info, "bitrate", fl_value_new_int(bitrate));
+		} else {
+			sprintf(p, "track-list/%d/demux-bitrate", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &bitrate)) {
+				fl_value_set_string_take(info, "bitrate", fl_value_new_int(bitrate));
+			}
+		}
+		sprintf(p, "track-list/%d/codec", i);
+		if (!mpv_get_property(mpv, p, MPV_FORMAT_STRING, &str)) {
+			fl_value_set_string_take(info, "format", fl_value_new_string(str));
+			mpv_free(str);
+		} else {
+			sprintf(p, "track-list/%d/format-name", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_STRING, &str)) {
+				fl_value_set_string_take(info, "format", fl_value_new_string(str));
+				mpv_free(str);
+			}
+		}
+		if (type == 0) {
+			AvMediaPlayerVideoTrack track = { (uint16_t)trackId, 0, 0, bitrate };
+			sprintf(p, "track-list/%d/demux-w", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &size)) {
+				fl_value_set_string_take(info, "width", fl_value_new_int(size));
+				track.width = (uint16_t)size;
+			}
+			sprintf(p, "track-list/%d/demux-h", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &size)) {
+				fl_value_set_string_take(info, "height", fl_value_new_int(size));
+				track.height = (uint16_t)size;
+			}
+			if (videoTracks) {
+				g_array_append_val(videoTracks, track);
+			}
+			double fps;
+			sprintf(p, "track-list/%d/demux-fps", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_DOUBLE, &fps)) {
+				fl_value_set_string_take(info, "frameRate", fl_value_new_float(fps));
+			}
+		} else if (type == 1) {
+			sprintf(p, "track-list/%d/demux-channel-count", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &size)) {
+				fl_value_set_string_take(info, "channels", fl_value_new_int(size));
+			}
+			sprintf(p, "track-list/%d/demux-samplerate", i);
+			if (!mpv_get_property(mpv, p, MPV_FORMAT_INT64, &size)) {
+				fl_value_set_string_take(info, "sampleRate", fl_value_new_int(size));
+			}
+		}
+		sprintf(p, "%d.%ld", type, trackId);
+		fl_value_set_string_take(tracks, p, info);
+	}
+	return tracks;
+}
+
+/* media info cache */
+typedef struct {
+	gchar* identity;
+	GBytes* data;
+} AvMediaPlayerInfoEntry;
+
+static gchar* media_info_identity(const gchar* path) {
+	// network media is identified by url, local files by path, mtime and size
+	if (g_str_has_prefix(path, "http://") || g_str_has_prefix(path, "https://")) {
+		g_autofree gchar* validator = av_media_player_proxy_validator(path);
+		return validator ? g_strdup_printf("%s|%s", path, validator) : g_strdup(path);
+	}
+	g_autofree gchar* filename = g_str_has_prefix(path, "file://") ? g_filename_from_uri(path, NULL, NULL) : strstr(path, "://") ? NULL : g_strdup(path);
+	GStatBuf st;
+	if (!filename || g_stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+	return g_strdup_printf("%s|%" G_GINT64_FORMAT "|%" G_GINT64_FORMAT, filename, (gint64)st.st_mtime, (gint64)st.st_size);
+}
+
+static gchar* media_info_file(const gchar* identity) {
+	g_autofree gchar* hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, identity, -1);
+	g_autofree gchar* name = g_strconcat(hash, ".bin", NULL);
+	return g_build_filename(g_get_user_cache_dir(), "av_media_player", "info", name, NULL);
+}
+
+static FlValue* media_info_load(const gchar* identity) {
+	// entries are tiny, mapping them avoids a copy and lets the page cache serve repeated opens
+	g_autofree gchar* file = media_info_file(identity);
+	GMappedFile* mapped = g_mapped_file_new(file, FALSE, NULL);
+	if (!mapped) {
+		return NULL;
+	}
+	g_autoptr(GBytes) data = g_mapped_file_get_bytes(mapped);
+	g_mapped_file_unref(mapped);
+	g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+	g_autoptr(FlValue) entry = fl_message_codec_decode_message(FL_MESSAGE_CODEC(codec), data, NULL);
+	if (!entry || fl_value_get_type(entry) != FL_VALUE_TYPE_MAP) {
+		return NULL;
+	}
+	FlValue* key = fl_value_lookup_string(entry, "identity");
+	FlValue* info = fl_value_lookup_string(entry, "info");
+	if (!key || fl_value_get_type(key) != FL_VALUE_TYPE_STRING || !g_str_equal(fl_value_get_string(key), identity) || !info || fl_value_get_type(info) != FL_VALUE_TYPE_MAP) {
+		return NULL;
+	}
+	return fl_value_ref(info);
+}
+
+static void media_info_write(gpointer data, gpointer user_data) {
+	AvMediaPlayerInfoEntry* entry = data;
+	g_autofree gchar* file = media_info_file(entry->identity);
+	g_autofree gchar* dir = g_path_get_dirname(file);
+	gsize size;
+	const gchar* bytes = g_bytes_get_data(entry->data, &size);
+	if (g_mkdir_with_parents(dir, 0755) == 0) {
+		g_file_set_contents(file, bytes, size, NULL); // replaces the file atomically, so readers never see a partial entry
+	}
+	g_free(entry->identity);
+	g_bytes_unref(entry->data);
+	g_free(entry);
+}
+
+static void media_info_store(const gchar* identity, FlValue* info, GThreadPool* pool) {
+	// the entry is written in the calling thread if pool is NULL
+	g_autoptr(FlValue) value = fl_value_new_map();
+	fl_value_set_string_take(value, "identity", fl_value_new_string(identity));
+	fl_value_set_string(value, "info", info);
+	g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+	GBytes* data = fl_message_codec_encode_message(FL_MESSAGE_CODEC(codec), value, NULL);
+	if (data) {
+		AvMediaPlayerInfoEntry* entry = g_new(AvMediaPlayerInfoEntry, 1);
+		entry->identity = g_strdup(identity);
+		entry->data = data;
+		if (pool) {
+			g_thread_pool_push(pool, entry, NULL);
+		} else {
+			media_info_write(entry, NULL);
+		}
+	}
+}
+
+static FlValue* media_info_from_pack(const gchar* url) {
+	g_autoptr(GBytes) meta = g_str_has_prefix(url, "pack://") ? av_media_player_stream_get_meta(url) : NULL;
+	if (!meta) {
+		return NULL;
+	}
+	g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+	FlValue* info = fl_message_codec_decode_message(FL_MESSAGE_CODEC(codec), meta, NULL);
+	if (info && fl_value_get_type(info) != FL_VALUE_TYPE_MAP) {
+		fl_value_unref(info);
+		return NULL;
+	}
+	return info;
+}
+
 /* player implementation */
 static gboolean av_media_player_is_eof(AvMediaPlayer* self) {
 	gboolean eof;
@@ -97,18 +541,1149 @@ static void av_media_player_set_pause(AvMediaPlayer* self, gboolean pause) {
 
 static void av_media_player_rewind(AvMediaPlayer* self) {
 	const gchar* cmd[] = { "seek", "0.1", "absolute+keyframes", NULL }; //use 0.1 instead of 0 to workaround mpv bug
-	mpv_command(self->mpv, cmd);
+	if (mpv_command(self->mpv, cmd) == 0) {
+		self->seeking = true;
+	}
 }
 
+static void av_media_player_seek(AvMediaPlayer* self, const int64_t position, const gchar* flags) {
+	gchar* t = g_strdup_printf("%lf", (double)position / 1000);
+	const gchar* cmd[] = { "seek", t, flags, NULL };
+	if (mpv_command(self->mpv, cmd) == 0) {
+		self->seeking = true;
+	}
+	g_free(t);
+}
+
+static void av_media_player_apply_loop(AvMediaPlayer* self) {
+	// let mpv loop natively, so there is no pause or seek round trip at the end of each loop
+	mpv_set_property_string(self->mpv, "loop-file", self->looping && !self->streaming ? "inf" : "no");
+	if (self->loopEnd > self->loopBegin && !self->streaming) {
+		double a = (double)self->loopBegin / 1000;
+		double b = (double)self->loopEnd / 1000;
+		mpv_set_property(self->mpv, "ab-loop-a", MPV_FORMAT_DOUBLE, &a);
+		mpv_set_property(self->mpv, "ab-loop-b", MPV_FORMAT_DOUBLE, &b);
+	} else {
+		mpv_set_property_string(self->mpv, "ab-loop-a", "no");
+		mpv_set_property_string(self->mpv, "ab-loop-b", "no");
+	}
+}
+
+static void av_media_player_send_position(AvMediaPlayer* self) {
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("position"));
+	fl_value_set_string_take(evt, "value", fl_value_new_int(self->position));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+}
+
+static void av_media_player_send_clip_memory(AvMediaPlayer* self) {
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("clipMemory"));
+	fl_value_set_string_take(evt, "value", fl_value_new_int(self->clipMemory));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+}
+
+/* subtitle overlay, only redrawn when the cue, the visibility or the video size changes */
+static void av_media_player_subtitle_size(AvMediaPlayer* self, GLsizei* width, GLsizei* height) {
+	// the overlay is stretched over the video, so it never needs more pixels than the largest monitor shows
+	int maxWidth = 0;
+	int maxHeight = 0;
+	GdkDisplay* display = gdk_display_get_default();
+	for (int i = 0; display && i < gdk_display_get_n_monitors(display); i++) {
+		GdkMonitor* monitor = gdk_display_get_monitor(display, i);
+		GdkRectangle geometry;
+		gdk_monitor_get_geometry(monitor, &geometry);
+		const int scale = gdk_monitor_get_scale_factor(monitor);
+		maxWidth = MAX(maxWidth, geometry.width * scale);
+		maxHeight = MAX(maxHeight, geometry.height * scale);
+	}
+	double scale = 1;
+	if (maxWidth > 0 && maxHeight > 0) {
+		scale = MIN(scale, MIN((double)maxWidth / self->width, (double)maxHeight / self->height));
+	}
+	*width = MAX((GLsizei)(self->width * scale), 1);
+	*height = MAX((GLsizei)(self->height * scale), 1);
+}
+
+static void av_media_player_render_subtitle(AvMediaPlayer* self) {
+	GLsizei width = 1;
+	GLsizei height = 1;
+	guint8* pixels;
+	if (self->showSubtitle && self->subOverlay && self->subText && self->subText[0] && self->width > 0 && self->height > 0) {
+		av_media_player_subtitle_size(self, &width, &height);
+		cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+		cairo_t* cr = cairo_create(surface);
+		PangoLayout* layout = pango_cairo_create_layout(cr);
+		PangoFontDescription* font = pango_font_description_from_string("Sans");
+		pango_font_description_set_absolute_size(font, height / 18.0 * PANGO_SCALE);
+		pango_layout_set_font_description(layout, font);
+		pango_font_description_free(font);
+		pango_layout_set_width(layout, (int)(width * 0.9) * PANGO_SCALE);
+		pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+		pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+		pango_layout_set_text(layout, self->subText, -1);
+		int textHeight;
+		pango_layout_get_pixel_size(layout, NULL, &textHeight);
+		const int top = MAX(0, height - height / 20 - textHeight);
+		cairo_move_to(cr, width * 0.05, top);
+		pango_cairo_layout_path(cr, layout);
+		cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+		cairo_set_line_width(cr, height / 270.0 + 1);
+		cairo_set_source_rgba(cr, 0, 0, 0, 1);
+		cairo_stroke_preserve(cr);
+		cairo_set_source_rgba(cr, 1, 1, 1, 1);
+		cairo_fill(cr);
+		g_object_unref(layout);
+		cairo_destroy(cr);
+		cairo_surface_flush(surface);
+		// cairo stores premultiplied argb words in native byte order, rows above the outlined text are left blank
+		const guint8* data = cairo_image_surface_get_data(surface);
+		const int stride = cairo_image_surface_get_stride(surface);
+		pixels = g_malloc0((gsize)width * height * 4);
+		for (int y = MAX(0, top - height / 100 - 2); y < height; y++) {
+			const uint32_t* src = (const uint32_t*)(data + (gsize)y * stride);
+			guint8* dst = pixels + (gsize)y * width * 4;
+			for (int x = 0; x < width; x++, dst += 4) {
+				dst[0] = (guint8)(src[x] >> 16);
+				dst[1] = (guint8)(src[x] >> 8);
+				dst[2] = (guint8)src[x];
+				dst[3] = (guint8)(src[x] >> 24);
+			}
+		}
+		cairo_surface_destroy(surface);
+	} else {
+		pixels = g_malloc0(4);
+	}
+	AvMediaPlayerSubtitle* subtitle = self->subtitle;
+	g_mutex_lock(&subtitle->mutex);
+	g_free(subtitle->pixels);
+	subtitle->pixels = pixels;
+	subtitle->width = width;
+	subtitle->height = height;
+	subtitle->dirty = true;
+	g_mutex_unlock(&subtitle->mutex);
+	fl_texture_registrar_mark_texture_frame_available(self->textureRegistrar, FL_TEXTURE(subtitle));
+}
+
+static void av_media_player_set_sub_codec(AvMediaPlayer* self, const gchar* codec) {
+	// the overlay only draws plain text, so mpv keeps rendering bitmap and ass subtitles with their own look
+	static const gchar* const rendered[] = { "ass", "ssa", "hdmv_pgs_subtitle", "dvd_subtitle", "dvb_subtitle", "dvb_teletext", "xsub", NULL };
+	const bool overlay = !codec || !g_strv_contains(rendered, codec);
+	if (self->subOverlay != overlay) {
+		self->subOverlay = overlay;
+		mpv_set_property_string(self->mpv, "sub-visibility", self->showSubtitle && !overlay ? "yes" : "no");
+		if (self->subText) {
+			av_media_player_render_subtitle(self);
+		}
+	}
+}
+
+static void av_media_player_set_sub_text(AvMediaPlayer* self, const gchar* text) {
+	if (text && !text[0]) {
+		text = NULL;
+	}
+	if (g_strcmp0(text, self->subText) != 0) {
+		const bool visible = self->showSubtitle && self->subOverlay && (self->subText || text);
+		g_free(self->subText);
+		self->subText = g_strdup(text);
+		if (visible) {
+			av_media_player_render_subtitle(self);
+		}
+	}
+}
+
+/* external subtitles, files are parsed in a worker thread into a time sorted cue index which feeds the overlay */
+#define AV_MEDIA_PLAYER_SUBTITLE_FILE_ID 1000 // track ids of external subtitles start here, far above the ids of mpv
+
+typedef struct {
+	FlMethodCall* call;
+	int64_t id;      // player id
+	gchar* source;   // the media the subtitle is added to
+	gchar* path;
+	gchar* language;
+	AvMediaPlayerSubtitleFile* file; // NULL if the file can't be read or has no cues
+} AvMediaPlayerSubtitleJob;
+
+static void av_media_player_subtitle_file_free(gpointer data) {
+	AvMediaPlayerSubtitleFile* file = data;
+	g_free(file->language);
+	g_array_free(file->cues, TRUE);
+	g_string_chunk_free(file->texts);
+	g_free(file);
+}
+
+static int64_t av_media_player_parse_cue_time(const gchar* s, const gchar** end) {
+	// [hh:]mm:ss[.,]fff of srt and webvtt or h:mm:ss.cc of ass, returns -1 if s doesn't start with a time
+	int64_t parts[3];
+	int count = 0;
+	while (*s == ' ' || *s == '\t') {
+		s++;
+	}
+	while (count < 3 && g_ascii_isdigit(*s)) {
+		int64_t value = 0;
+		while (g_ascii_isdigit(*s)) {
+			value = value * 10 + (*s++ - '0');
+		}
+		parts[count++] = value;
+		if (*s != ':') {
+			break;
+		}
+		s++;
+	}
+	if (count < 2) {
+		return -1;
+	}
+	int64_t ms = 0;
+	if (*s == '.' || *s == ',') {
+		s++;
+		for (int64_t scale = 100; g_ascii_isdigit(*s); scale /= 10) {
+			ms += (*s++ - '0') * scale;
+		}
+	}
+	if (end) {
+		*end = s;
+	}
+	return (count == 3 ? parts[0] * 3600 + parts[1] * 60 + parts[2] : parts[0] * 60 + parts[1]) * 1000 + ms;
+}
+
+static void av_media_player_append_cue_text(GString* out, const gchar* text, const gchar* end, const bool ass) {
+	// drops html style tags and ass override blocks, the overlay draws plain text
+	while (text < end) {
+		if (*text == '<' || *text == '{') {
+			const gchar* close = memchr(text, *text == '<' ? '>' : '}', end - text);
+			if (close) {
+				text = close + 1;
+				continue;
+			}
+		}
+		if (ass && *text == '\\' && text + 1 < end && (text[1] == 'N' || text[1] == 'n' || text[1] == 'h')) {
+			g_string_append_c(out, text[1] == 'h' ? ' ' : '\n');
+			text += 2;
+		} else {
+			g_string_append_c(out, *text++);
+		}
+	}
+}
+
+static void av_media_player_add_cue(AvMediaPlayerSubtitleFile* file, const int64_t start, const int64_t end, GString* text) {
+	while (text->len > 0 && text->str[text->len - 1] == '\n') {
+		g_string_truncate(text, text->len - 1);
+	}
+	if (start >= 0 && end > start && text->len > 0) {
+		AvMediaPlayerCue cue = { start, end, 0, g_string_chunk_insert_len(file->texts, text->str, text->len) };
+		g_array_append_val(file->cues, cue);
+	}
+	g_string_truncate(text, 0);
+}
+
+static gint av_media_player_compare_cue(gconstpointer a, gconstpointer b) {
+	const AvMediaPlayerCue* x = a;
+	const AvMediaPlayerCue* y = b;
+	return x->start != y->start ? (x->start < y->start ? -1 : 1) : x->end < y->end ? -1 : x->end > y->end ? 1 : 0;
+}
+
+static AvMediaPlayerSubtitleFile* av_media_player_subtitle_file_parse(const gchar* data, gsize length) {
+	// supports srt, webvtt and the dialogue lines of ass/ssa, returns NULL if there's no cue
+	gchar* converted = NULL;
+	if (!g_utf8_validate(data, length, NULL)) {
+		// legacy subtitles that are not utf-8 are mostly windows-1252
+		converted = g_convert(data, length, "UTF-8", "WINDOWS-1252", NULL, &length, NULL);
+		if (!converted) {
+			return NULL;
+		}
+		data = converted;
+	}
+	const gchar* p = data;
+	const gchar* end = data + length;
+	if (length >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+		p += 3;
+	}
+	AvMediaPlayerSubtitleFile* file = g_new0(AvMediaPlayerSubtitleFile, 1);
+	file->cues = g_array_new(FALSE, FALSE, sizeof(AvMediaPlayerCue));
+	file->texts = g_string_chunk_new(MIN(length, 1 << 20) + 1);
+	const bool ass = g_strstr_len(p, MIN(end - p, 4096), "[Script Info]") || g_strstr_len(p, end - p, "[Events]");
+	file->format = ass ? "ass" : g_str_has_prefix(p, "WEBVTT") ? "webvtt" : "srt";
+	GString* text = g_string_new(NULL);
+	int64_t start = -1;
+	int64_t stop = -1;
+	int startField = 1; // ass fields of the default format line
+	int endField = 2;
+	int textField = 9;
+	bool events = false;
+	while (p < end) {
+		const gchar* eol = memchr(p, '\n', end - p);
+		if (!eol) {
+			eol = end;
+		}
+		const gchar* lineEnd = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+		if (ass) {
+			if (*p == '[') {
+				events = g_str_has_prefix(p, "[Events]");
+			} else if (events && g_str_has_prefix(p, "Format:")) {
+				int field = 0;
+				for (const gchar* s = p + 7; s < lineEnd; field++) {
+					while (s < lineEnd && *s == ' ') {
+						s++;
+					}
+					if (g_str_has_prefix(s, "Start")) {
+						startField = field;
+					} else if (g_str_has_prefix(s, "End")) {
+						endField = field;
+					} else if (g_str_has_prefix(s, "Text")) {
+						textField = field;
+					}
+					const gchar* comma = memchr(s, ',', lineEnd - s);
+					s = comma ? comma + 1 : lineEnd;
+				}
+			} else if (events && g_str_has_prefix(p, "Dialogue:")) {
+				// text is the last field and may contain commas
+				const gchar* s = p + 9;
+				for (int field = 0; s < lineEnd; field++) {
+					if (field == textField) {
+						av_media_player_append_cue_text(text, s, lineEnd, true);
+						av_media_player_add_cue(file, start, stop, text);
+						break;
+					} else if (field == startField) {
+						start = av_media_player_parse_cue_time(s, NULL);
+					} else if (field == endField) {
+						stop = av_media_player_parse_cue_time(s, NULL);
+					}
+					const gchar* comma = memchr(s, ',', lineEnd - s);
+					s = comma ? comma + 1 : lineEnd;
+				}
+				start = -1;
+				stop = -1;
+			}
+		} else {
+			const gchar* arrow = g_strstr_len(p, lineEnd - p, "-->");
+			if (arrow) {
+				av_media_player_add_cue(file, start, stop, text);
+				start = av_media_player_parse_cue_time(p, NULL);
+				stop = av_media_player_parse_cue_time(arrow + 3, NULL);
+			} else if (lineEnd == p) {
+				av_media_player_add_cue(file, start, stop, text);
+				start = -1;
+			} else if (start >= 0) {
+				av_media_player_append_cue_text(text, p, lineEnd, false);
+				g_string_append_c(text, '\n');
+			}
+		}
+		p = eol + 1;
+	}
+	av_media_player_add_cue(file, start, stop, text);
+	g_string_free(text, TRUE);
+	g_free(converted);
+	if (file->cues->len == 0) {
+		av_media_player_subtitle_file_free(file);
+		return NULL;
+	}
+	g_array_sort(file->cues, av_media_player_compare_cue);
+	int64_t reach = 0;
+	for (guint i = 0; i < file->cues->len; i++) {
+		AvMediaPlayerCue* cue = &g_array_index(file->cues, AvMediaPlayerCue, i);
+		reach = MAX(reach, cue->end);
+		cue->reach = reach;
+	}
+	return file;
+}
+
+static FlValue* av_media_player_subtitle_file_info(AvMediaPlayerSubtitleFile* file) {
+	FlValue* info = fl_value_new_map();
+	fl_value_set_string_take(info, "type", fl_value_new_string("subtitle"));
+	fl_value_set_string_take(info, "format", fl_value_new_string(file->format));
+	if (file->language) {
+		fl_value_set_string_take(info, "language", fl_value_new_string(file->language));
+	}
+	return info;
+}
+
+static void av_media_player_update_cue(AvMediaPlayer* self, const int64_t pos) {
+	if (pos >= self->cueFrom && pos < self->cueUntil) {
+		return;
+	}
+	GArray* cues = self->subtitleFile->cues;
+	// find the first cue that starts after pos, the active cues are before it
+	guint low = 0;
+	guint high = cues->len;
+	while (low < high) {
+		guint mid = (low + high) / 2;
+		if (g_array_index(cues, AvMediaPlayerCue, mid).start <= pos) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	int64_t until = low < cues->len ? g_array_index(cues, AvMediaPlayerCue, low).start : G_MAXINT64;
+	GString* text = g_string_new(NULL);
+	for (guint i = low; i > 0 && g_array_index(cues, AvMediaPlayerCue, i - 1).reach > pos; i--) {
+		AvMediaPlayerCue* cue = &g_array_index(cues, AvMediaPlayerCue, i - 1);
+		if (cue->end > pos) {
+			until = MIN(until, cue->end);
+			if (text->len > 0) {
+				g_string_prepend_c(text, '\n');
+			}
+			g_string_prepend(text, cue->text);
+		}
+	}
+	self->cueFrom = pos;
+	self->cueUntil = until;
+	av_media_player_set_sub_text(self, text->str);
+	g_string_free(text, TRUE);
+}
+
+static bool av_media_player_select_subtitle_file(AvMediaPlayer* self, const uint16_t trackId) {
+	// returns false if trackId is not an external subtitle
+	self->subtitleFile = NULL;
+	self->cueFrom = 0;
+	self->cueUntil = 0;
+	if (trackId >= AV_MEDIA_PLAYER_SUBTITLE_FILE_ID && trackId - AV_MEDIA_PLAYER_SUBTITLE_FILE_ID < self->subtitleFiles->len) {
+		self->subtitleFile = g_ptr_array_index(self->subtitleFiles, trackId - AV_MEDIA_PLAYER_SUBTITLE_FILE_ID);
+		av_media_player_update_cue(self, self->position);
+		return true;
+	}
+	av_media_player_set_sub_text(self, NULL);
+	return false;
+}
+
+static void av_media_player_subtitle_file_answer(AvMediaPlayer* self, AvMediaPlayerSubtitleJob* job) {
+	// self is NULL if the player is gone
+	const bool current = self && job->file && g_strcmp0(self->source, job->source) == 0;
+	if (current && self->state == 1) {
+		// the tracks of mpv are not known yet, answered by av_media_player_subtitle_file_flush
+		g_ptr_array_add(self->subtitleJobs, job);
+		return;
+	}
+	g_autoptr(FlValue) result = NULL;
+	if (current && self->state > 1) {
+		AvMediaPlayerSubtitleFile* file = job->file;
+		job->file = NULL;
+		file->id = (uint16_t)(AV_MEDIA_PLAYER_SUBTITLE_FILE_ID + self->subtitleFiles->len);
+		g_ptr_array_add(self->subtitleFiles, file);
+		gchar* trackId = g_strdup_printf("2.%d", file->id);
+		result = fl_value_new_map();
+		fl_value_set_string_take(result, "trackId", fl_value_new_string(trackId));
+		fl_value_set_string_take(result, "track", av_media_player_subtitle_file_info(file));
+		g_free(trackId);
+	} else {
+		result = fl_value_new_null();
+	}
+	fl_method_call_respond_success(job->call, result, NULL);
+	if (job->file) {
+		av_media_player_subtitle_file_free(job->file);
+	}
+	g_object_unref(job->call);
+	g_free(job->source);
+	g_free(job->path);
+	g_free(job->language);
+	g_free(job);
+}
+
+static void av_media_player_subtitle_file_flush(AvMediaPlayer* self, const bool disposed) {
+	// answers the parked jobs once the media is loaded or closed, or the player is disposed
+	for (uint i = 0; i < self->subtitleJobs->len; i++) {
+		av_media_player_subtitle_file_answer(disposed ? NULL : self, g_ptr_array_index(self->subtitleJobs, i));
+	}
+	g_ptr_array_set_size(self->subtitleJobs, 0);
+}
+
+static gboolean av_media_player_subtitle_file_respond(void* data) {
+	AvMediaPlayerSubtitleJob* job = data;
+	// the players are gone once the plugin is disposed
+	AvMediaPlayer* self = g_atomic_int_get(&plugin->subtitleCancelled) ? NULL : g_tree_lookup(plugin->players, (gpointer)job->id);
+	av_media_player_subtitle_file_answer(self, job);
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_subtitle_file_run(gpointer data, gpointer user_data) {
+	AvMediaPlayerSubtitleJob* job = data;
+	if (g_atomic_int_get(&plugin->subtitleCancelled)) {
+		g_idle_add(av_media_player_subtitle_file_respond, job);
+		return;
+	}
+	GFile* file = strstr(job->path, "://") ? g_file_new_for_uri(job->path) : g_file_new_for_path(job->path);
+	gchar* contents;
+	gsize length;
+	if (g_file_load_contents(file, NULL, &contents, &length, NULL, NULL)) {
+		job->file = av_media_player_subtitle_file_parse(contents, length);
+		g_free(contents);
+		if (job->file && job->language) {
+			job->file->language = g_strdup(job->language);
+		}
+	}
+	g_object_unref(file);
+	g_idle_add(av_media_player_subtitle_file_respond, job);
+}
+
+/* clip mode: short muted clips are decoded once into textures, later loops are played from memory */
+static void av_media_player_clip_release(AvMediaPlayer* self) {
+	if (self->clipTimer) {
+		g_source_remove(self->clipTimer);
+		self->clipTimer = 0;
+	}
+	g_mutex_lock(&self->clipMutex);
+	for (uint i = 0; i < self->clipFrames->len; i++) {
+		g_array_append_val(self->staleTextures, g_array_index(self->clipFrames, AvMediaPlayerClipFrame, i).texture);
+	}
+	g_array_set_size(self->clipFrames, 0);
+	const uint8_t clipState = self->clipState;
+	self->clipState = 0;
+	const int64_t clipMemory = self->clipMemory;
+	self->clipMemory = 0;
+	g_mutex_unlock(&self->clipMutex);
+	if (clipState > 0) {
+		mpv_set_property_string(self->mpv, "aid", "auto");
+		mpv_set_property_string(self->mpv, "framedrop", "vo");
+		av_media_player_mark(self); // lets the render thread delete the textures
+	}
+	if (clipMemory > 0) {
+		av_media_player_send_clip_memory(self);
+	}
+}
+
+static void av_media_player_delete_stale(AvMediaPlayer* self) {
+	// called in the render thread, where the textures were created
+	g_mutex_lock(&self->clipMutex);
+	if (self->staleTextures->len > 0) {
+		for (uint i = 0; i < self->staleTextures->len; i++) {
+			if (g_array_index(self->staleTextures, GLuint, i) == self->shownTexture) {
+				// mirrors and walls must not read it anymore, the name may be reused right away
+				self->shownTexture = 0;
+				self->shownSerial++;
+			}
+		}
+		glDeleteTextures((GLsizei)self->staleTextures->len, (GLuint*)self->staleTextures->data);
+		g_array_set_size(self->staleTextures, 0);
+	}
+	for (uint i = 0; i < self->staleTaps->len; i++) {
+		av_media_player_tap_free(g_ptr_array_index(self->staleTaps, i));
+	}
+	g_ptr_array_set_size(self->staleTaps, 0);
+	g_mutex_unlock(&self->clipMutex);
+}
+
+static int64_t av_media_player_clip_pos(AvMediaPlayer* self) {
+	int64_t pos = self->clipClock;
+	if (self->state > 2) {
+		pos += (int64_t)((g_get_monotonic_time() - self->clipClockTime) * self->speed / 1000);
+	}
+	return pos;
+}
+
+static void av_media_player_clip_set_clock(AvMediaPlayer* self, const int64_t pos) {
+	// the render thread reads the clock in av_media_player_clip_frame
+	g_mutex_lock(&self->clipMutex);
+	self->clipClock = pos;
+	self->clipClockTime = g_get_monotonic_time();
+	g_mutex_unlock(&self->clipMutex);
+}
+
+static gboolean av_media_player_clip_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self || self->clipState < 2 || self->state < 3) {
+		if (self) {
+			self->clipTimer = 0;
+		}
+		return G_SOURCE_REMOVE;
+	}
+	int64_t pos = av_media_player_clip_pos(self);
+	if (pos >= self->clipDuration) {
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("finished"));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+		if (self->looping) {
+			pos %= self->clipDuration;
+			av_media_player_clip_set_clock(self, pos);
+		} else {
+			pos = self->clipDuration;
+			av_media_player_clip_set_clock(self, pos);
+			self->state = 2;
+			self->clipTimer = 0;
+		}
+	}
+	if (self->position != pos) {
+		self->position = pos;
+		av_media_player_send_position(self);
+	}
+	av_media_player_mark(self);
+	return self->clipTimer ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static void av_media_player_clip_start(AvMediaPlayer* self) {
+	if (self->clipState == 2 && self->state > 2 && !self->clipTimer) {
+		// tick at the captured frame rate, the populate callback picks the frame to show
+		guint interval = (guint)(self->clipDuration / MAX(self->clipFrames->len, 1));
+		self->clipTimer = g_timeout_add(MAX(interval, 8), av_media_player_clip_tick, (gpointer)self->id);
+	}
+}
+
+static bool av_media_player_clip_complete(AvMediaPlayer* self) {
+	// the caller holds clipMutex, a clip is complete when no frame is missing between the start and the end
+	const int64_t gap = self->clipInterval * 3 / 2;
+	int64_t last = 0;
+	for (uint i = 0; i < self->clipFrames->len; i++) {
+		const int64_t pts = g_array_index(self->clipFrames, AvMediaPlayerClipFrame, i).pts;
+		if (pts - last > gap) {
+			return false;
+		}
+		last = pts;
+	}
+	return self->clipFrames->len > 0 && self->clipDuration - last <= gap;
+}
+
+static gboolean av_media_player_clip_finish(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (self && self->clipState == 1) {
+		g_mutex_lock(&self->clipMutex);
+		const bool captured = self->clipFrames->len > 0;
+		if (captured) {
+			self->clipState = 2;
+		}
+		g_mutex_unlock(&self->clipMutex);
+		if (!captured) {
+			// nothing was captured before the end, play the media as usual
+			av_media_player_clip_release(self);
+			return G_SOURCE_REMOVE;
+		}
+		// every frame is in memory now, so the decoder and demuxer are no longer needed
+		mpv_set_property_string(self->mpv, "framedrop", "vo");
+		av_media_player_clip_set_clock(self, av_media_player_is_eof(self) ? self->clipDuration : self->position);
+		const gchar* stop[] = { "stop", NULL };
+		mpv_command(self->mpv, stop);
+		av_media_player_send_clip_memory(self);
+		av_media_player_clip_start(self);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static GLuint av_media_player_copy_frame(AvMediaPlayer* self) {
+	// copies the frame in self->fbo into a new texture, called in the render thread
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, self->fbo.w, self->fbo.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, self->fbo.fbo);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, self->fbo.w, self->fbo.h);
+	return texture;
+}
+
+static GLuint av_media_player_clip_copy_frame(AvMediaPlayer* self) {
+	// scales the frame in self->fbo down into a 16 bit texture, called in the render thread
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB565, self->clipWidth, self->clipHeight, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (!self->clipFbo) {
+		glGenFramebuffers(1, &self->clipFbo);
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, self->clipFbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, self->fbo.fbo);
+	glBlitFramebuffer(0, 0, self->fbo.w, self->fbo.h, 0, 0, self->clipWidth, self->clipHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return texture;
+}
+
+static void av_media_player_clip_capture(AvMediaPlayer* self, const int64_t pts) {
+	// called in the render thread right after mpv rendered a frame into self->fbo
+	// framedrop is off while capturing, so mpv waits for every frame of the clip to be rendered here
+	if (pts >= 0) {
+		g_mutex_lock(&self->clipMutex);
+		if (self->clipState != 1) {
+			g_mutex_unlock(&self->clipMutex);
+			return;
+		}
+		if (self->clipFrames->len == 0) {
+			self->clipWidth = self->fbo.w;
+			self->clipHeight = self->fbo.h;
+			if (self->clipFrameWidth > 0 && self->clipFrameHeight > 0 && (self->clipWidth > self->clipFrameWidth || self->clipHeight > self->clipFrameHeight)) {
+				const double scale = MIN((double)self->clipFrameWidth / self->clipWidth, (double)self->clipFrameHeight / self->clipHeight);
+				self->clipWidth = (uint16_t)MAX(self->clipWidth * scale, 1);
+				self->clipHeight = (uint16_t)MAX(self->clipHeight * scale, 1);
+			}
+			self->clipLast = -1;
+			self->clipPasses = 0;
+		}
+		if (pts < self->clipLast) {
+			// the clip wrapped around, a later pass fills the frames missed by the previous ones
+			self->clipPasses++;
+			if (av_media_player_clip_complete(self) || self->clipPasses > 1) {
+				g_idle_add(av_media_player_clip_finish, (gpointer)self->id);
+			}
+		}
+		self->clipLast = pts;
+		uint i = self->clipFrames->len;
+		while (i > 0 && g_array_index(self->clipFrames, AvMediaPlayerClipFrame, i - 1).pts > pts) {
+			i--;
+		}
+		if (i == 0 || g_array_index(self->clipFrames, AvMediaPlayerClipFrame, i - 1).pts < pts) {
+			AvMediaPlayerClipFrame frame = { av_media_player_clip_copy_frame(self), pts };
+			g_array_insert_val(self->clipFrames, i, frame);
+			self->clipMemory += (int64_t)self->clipWidth * self->clipHeight * 2;
+		}
+		g_mutex_unlock(&self->clipMutex);
+	}
+}
+
+static GLuint av_media_player_clip_frame(AvMediaPlayer* self) {
+	// called in the render thread
+	g_mutex_lock(&self->clipMutex);
+	int64_t pos = av_media_player_clip_pos(self);
+	if (self->looping && self->clipDuration > 0) {
+		pos %= self->clipDuration;
+	}
+	GLuint texture = 0;
+	for (uint i = 0; i < self->clipFrames->len; i++) {
+		AvMediaPlayerClipFrame* frame = &g_array_index(self->clipFrames, AvMediaPlayerClipFrame, i);
+		if (texture == 0 || frame->pts <= pos) {
+			texture = frame->texture;
+		} else {
+			break;
+		}
+	}
+	g_mutex_unlock(&self->clipMutex);
+	return texture;
+}
+
+/* frame stepping, the frames decoded while stepping are kept as textures so repeated steps backward are served from memory */
+#define AV_MEDIA_PLAYER_STEP_MEMORY ((int64_t)256 << 20) // the oldest frames are dropped beyond this
+
+static void av_media_player_step_clear(AvMediaPlayer* self) {
+	// the caller holds clipMutex, the textures are deleted in the render thread by av_media_player_delete_stale
+	for (uint i = 0; i < self->stepFrames->len; i++) {
+		g_array_append_val(self->staleTextures, g_array_index(self->stepFrames, AvMediaPlayerClipFrame, i).texture);
+	}
+	g_array_set_size(self->stepFrames, 0);
+	self->stepMemory = 0;
+	self->stepIndex = -1;
+}
+
+static void av_media_player_step_respond(AvMediaPlayer* self, const int64_t pts) {
+	// pts is the position of the shown frame, or -1 if no step was made
+	if (pts >= 0 && self->position != pts) {
+		self->position = pts;
+		av_media_player_send_position(self);
+	}
+	if (self->stepCall) {
+		g_autoptr(FlValue) result = pts >= 0 ? fl_value_new_int(pts) : fl_value_new_null();
+		fl_method_call_respond_success(self->stepCall, result, NULL);
+		g_object_unref(self->stepCall);
+		self->stepCall = NULL;
+	}
+}
+
+static void av_media_player_drop_pending_step(AvMediaPlayer* self) {
+	if (self->pendingStepCall) {
+		fl_method_call_respond_success(self->pendingStepCall, NULL, NULL);
+		g_object_unref(self->pendingStepCall);
+		self->pendingStepCall = NULL;
+	}
+}
+
+static void av_media_player_step_reset(AvMediaPlayer* self) {
+	// playback moved on, so the cached frames are no longer around the position
+	self->stepState = 0;
+	g_mutex_lock(&self->clipMutex);
+	if (self->stepFrames->len > 0) {
+		av_media_player_step_clear(self);
+		av_media_player_mark(self);
+	}
+	g_mutex_unlock(&self->clipMutex);
+	av_media_player_step_respond(self, -1);
+}
+
+static gboolean av_media_player_step_next(void* id) {
+	// called after a new frame was rendered while stepping
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self) {
+		return G_SOURCE_REMOVE;
+	}
+	g_mutex_lock(&self->clipMutex);
+	const int64_t pts = self->stepLast;
+	g_mutex_unlock(&self->clipMutex);
+	if (self->stepState == 1) {
+		self->stepState = 0;
+		av_media_player_step_respond(self, pts);
+	} else if (self->stepState == 3) {
+		// the current frame is cached, now decode its group of pictures from the keyframe before it
+		self->stepState = 2;
+		av_media_player_seek(self, self->stepTarget - 1, "absolute+keyframes");
+	} else if (self->stepState == 2 && pts < self->stepTarget) {
+		const gchar* cmd[] = { "frame-step", NULL };
+		mpv_command(self->mpv, cmd);
+	} else if (self->stepState == 2) {
+		self->stepState = 0;
+		int64_t shown = -1;
+		g_mutex_lock(&self->clipMutex);
+		for (int i = (int)self->stepFrames->len - 1; i >= 0; i--) {
+			if (g_array_index(self->stepFrames, AvMediaPlayerClipFrame, i).pts < self->stepTarget) {
+				self->stepIndex = i;
+				shown = g_array_index(self->stepFrames, AvMediaPlayerClipFrame, i).pts;
+				break;
+			}
+		}
+		g_mutex_unlock(&self->clipMutex);
+		av_media_player_mark(self);
+		av_media_player_step_respond(self, shown);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_step_capture(AvMediaPlayer* self, const int64_t pts) {
+	// called in the render thread right after mpv rendered a frame into self->fbo
+	if (pts >= 0) {
+		g_mutex_lock(&self->clipMutex);
+		if (pts != self->stepLast) {
+			self->stepLast = pts;
+			GArray* frames = self->stepFrames;
+			uint i = 0;
+			while (i < frames->len && g_array_index(frames, AvMediaPlayerClipFrame, i).pts < pts) {
+				i++;
+			}
+			if (i == frames->len || g_array_index(frames, AvMediaPlayerClipFrame, i).pts != pts) {
+				AvMediaPlayerClipFrame frame = { av_media_player_copy_frame(self), pts };
+				g_array_insert_val(frames, i, frame);
+				self->stepMemory += (int64_t)self->fbo.w * self->fbo.h * 4;
+				while (self->stepMemory > AV_MEDIA_PLAYER_STEP_MEMORY && frames->len > 2) {
+					glDeleteTextures(1, &g_array_index(frames, AvMediaPlayerClipFrame, 0).texture);
+					g_array_remove_index(frames, 0);
+					self->stepMemory -= (int64_t)self->fbo.w * self->fbo.h * 4;
+				}
+			}
+			g_idle_add(av_media_player_step_next, (gpointer)self->id);
+		}
+		g_mutex_unlock(&self->clipMutex);
+	}
+}
+
+static GLuint av_media_player_step_frame_texture(AvMediaPlayer* self) {
+	// returns the cached frame to show instead of the output of mpv, 0 for none
+	GLuint texture = 0;
+	g_mutex_lock(&self->clipMutex);
+	if (self->stepIndex >= 0 && self->stepIndex < (int)self->stepFrames->len) {
+		texture = g_array_index(self->stepFrames, AvMediaPlayerClipFrame, self->stepIndex).texture;
+	} else if (self->stepState == 2 && self->stepFrames->len > 0) {
+		// keep showing the frame the step started from while the frames before it are decoded
+		texture = g_array_index(self->stepFrames, AvMediaPlayerClipFrame, self->stepFrames->len - 1).texture;
+	}
+	g_mutex_unlock(&self->clipMutex);
+	return texture;
+}
+
+/* snapshots, the shown frame is scaled on the gpu and read back through a pixel buffer, so the render thread never waits */
+#define AV_MEDIA_PLAYER_SNAPSHOT_TIMEOUT G_USEC_PER_SEC // a player that is not shown never renders the frame
+
+typedef struct {
+	FlMethodCall* call; // NULL once the job timed out, its gpu objects are still released in the render thread
+	uint8_t format;   // 0: png, 1: jpeg, 2: raw rgba
+	uint16_t maxSize; // longest side, 0 for the frame size
+	GLsizei width;
+	GLsizei height;
+	GLuint texture;   // scaled copy of the frame
+	GLuint fbo;
+	GLuint pbo;
+	GLsync fence;     // signaled once the pixels are in pbo
+	int64_t deadline; // monotonic time in microseconds
+	guint8* pixels;
+	FlValue* result;
+	gchar* error;
+} AvMediaPlayerSnapshotJob;
+
+static gboolean av_media_player_snapshot_respond(void* data) {
+	AvMediaPlayerSnapshotJob* job = data;
+	if (job->call && job->result) {
+		fl_method_call_respond_success(job->call, job->result, NULL);
+	} else if (job->call) {
+		fl_method_call_respond_error(job->call, "snapshot", job->error ? job->error : "unknown error", NULL, NULL);
+	}
+	if (job->result) {
+		fl_value_unref(job->result);
+	}
+	if (job->call) {
+		g_object_unref(job->call);
+	}
+	g_free(job->pixels);
+	g_free(job->error);
+	g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_snapshot_run(gpointer data, gpointer user_data) {
+	AvMediaPlayerSnapshotJob* job = data;
+	const gsize size = (gsize)job->width * job->height * 4;
+	FlValue* image = NULL;
+	if (job->format == 2) {
+		image = fl_value_new_uint8_list(job->pixels, size);
+	} else {
+		gboolean alpha = job->format == 0;
+		if (!alpha) {
+			// jpeg has no alpha channel, pack the pixels to rgb in place
+			for (gsize i = 0, j = 0; i < size; i += 4, j += 3) {
+				job->pixels[j] = job->pixels[i];
+				job->pixels[j + 1] = job->pixels[i + 1];
+				job->pixels[j + 2] = job->pixels[i + 2];
+			}
+		}
+		GdkPixbuf* pixbuf = gdk_pixbuf_new_from_data(job->pixels, GDK_COLORSPACE_RGB, alpha, 8, job->width, job->height, job->width * (alpha ? 4 : 3), NULL, NULL);
+		gchar* buffer;
+		gsize length;
+		GError* error = NULL;
+		gboolean saved = alpha ? gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &length, "png", &error, NULL) : gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &length, "jpeg", &error, "quality", "90", NULL);
+		if (saved) {
+			image = fl_value_new_uint8_list((const uint8_t*)buffer, length);
+			g_free(buffer);
+		} else {
+			job->error = g_strdup(error->message);
+			g_error_free(error);
+		}
+		g_object_unref(pixbuf);
+	}
+	if (image) {
+		job->result = fl_value_new_map();
+		fl_value_set_string_take(job->result, "data", image);
+		fl_value_set_string_take(job->result, "width", fl_value_new_int(job->width));
+		fl_value_set_string_take(job->result, "height", fl_value_new_int(job->height));
+	}
+	g_idle_add(av_media_player_snapshot_respond, job);
+}
+
+static void av_media_player_snapshot_update(AvMediaPlayer* self, const GLuint texture, const GLsizei width, const GLsizei height) {
+	// called in the render thread with the frame it's about to show
+	g_mutex_lock(&self->clipMutex);
+	for (uint i = 0; i < self->snapshots->len;) {
+		AvMediaPlayerSnapshotJob* job = g_ptr_array_index(self->snapshots, i);
+		if (!job->fence) {
+			const double scale = job->maxSize > 0 ? MIN(1.0, (double)job->maxSize / MAX(width, height)) : 1.0;
+			job->width = MAX((GLsizei)(width * scale), 1);
+			job->height = MAX((GLsizei)(height * scale), 1);
+			GLuint source;
+			glGenFramebuffers(1, &source);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+			glGenTextures(1, &job->texture);
+			glBindTexture(GL_TEXTURE_2D, job->texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, job->width, job->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glGenFramebuffers(1, &job->fbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, job->fbo);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, job->texture, 0);
+			// mpv renders without flipping, so row 0 already is the top of the frame
+			glBlitFramebuffer(0, 0, width, height, 0, 0, job->width, job->height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glDeleteFramebuffers(1, &source);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, job->fbo);
+			glGenBuffers(1, &job->pbo);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, job->pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)job->width * job->height * 4, NULL, GL_STREAM_READ);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, job->width, job->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+			i++;
+		} else if (glClientWaitSync(job->fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+			const gsize size = (gsize)job->width * job->height * 4;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, job->pbo);
+			const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+			if (data) {
+				job->pixels = g_malloc(size);
+				memcpy(job->pixels, data, size);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			glDeleteSync(job->fence);
+			glDeleteBuffers(1, &job->pbo);
+			glDeleteFramebuffers(1, &job->fbo);
+			glDeleteTextures(1, &job->texture);
+			g_ptr_array_remove_index(self->snapshots, i);
+			if (!job->call) {
+				av_media_player_snapshot_respond(job); // timed out, nobody waits for it anymore
+			} else if (job->pixels) {
+				g_thread_pool_push(plugin->snapshotPool, job, NULL);
+			} else {
+				job->error = g_strdup("failed to read the frame");
+				g_idle_add(av_media_player_snapshot_respond, job);
+			}
+		} else {
+			i++;
+		}
+	}
+	g_mutex_unlock(&self->clipMutex);
+}
+
+static gboolean av_media_player_snapshot_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self) {
+		return G_SOURCE_REMOVE;
+	}
+	const int64_t now = g_get_monotonic_time();
+	bool pending = false;
+	g_mutex_lock(&self->clipMutex);
+	for (uint i = 0; i < self->snapshots->len;) {
+		AvMediaPlayerSnapshotJob* job = g_ptr_array_index(self->snapshots, i);
+		if (job->call && now > job->deadline) {
+			// the render thread didn't get to it, most likely the player is not shown
+			fl_method_call_respond_error(job->call, "snapshot", "the frame was not rendered in time", NULL, NULL);
+			g_object_unref(job->call);
+			job->call = NULL;
+		}
+		if (!job->fence && !job->call) {
+			g_ptr_array_remove_index(self->snapshots, i);
+			av_media_player_snapshot_respond(job);
+		} else {
+			pending = pending || job->call;
+			i++;
+		}
+	}
+	pending = pending || self->tapPending;
+	g_mutex_unlock(&self->clipMutex);
+	if (!pending) {
+		// timed out jobs that are still read back are released by the next render
+		self->snapshotTimer = 0;
+		return G_SOURCE_REMOVE;
+	}
+	// a paused player renders no new frames, so ask for one to check the fences
+	av_media_player_mark(self);
+	return G_SOURCE_CONTINUE;
+}
+
+static void av_media_player_snapshot(AvMediaPlayer* self, const uint8_t format, const uint16_t maxSize, FlMethodCall* call) {
+	if (self->state < 2 || self->fbo.w == 0 || self->fbo.h == 0) {
+		fl_method_call_respond_success(call, NULL, NULL);
+		return;
+	}
+	if (!plugin->snapshotPool) {
+		plugin->snapshotPool = g_thread_pool_new(av_media_player_snapshot_run, NULL, 1, FALSE, NULL);
+	}
+	AvMediaPlayerSnapshotJob* job = g_new0(AvMediaPlayerSnapshotJob, 1);
+	job->call = g_object_ref(call);
+	job->format = format;
+	job->maxSize = maxSize;
+	job->deadline = g_get_monotonic_time() + AV_MEDIA_PLAYER_SNAPSHOT_TIMEOUT;
+	g_mutex_lock(&self->clipMutex);
+	g_ptr_array_add(self->snapshots, job);
+	g_mutex_unlock(&self->clipMutex);
+	if (!self->snapshotTimer) {
+		self->snapshotTimer = g_timeout_add(5, av_media_player_snapshot_tick, (gpointer)self->id);
+	}
+	av_media_player_mark(self);
+}
+
+/* frame tap, see av_media_player_tap.h */
+
+static gboolean av_media_player_tap_done(int64_t id, void* ring, const uint8_t* slot, const AvMediaPlayerFrame* frame, uint64_t sequence) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, (gpointer)id);
+	if (!self) {
+		return FALSE;
+	}
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("frame"));
+	fl_value_set_string_take(evt, "ring", fl_value_new_int((int64_t)ring));
+	fl_value_set_string_take(evt, "address", fl_value_new_int((int64_t)slot));
+	fl_value_set_string_take(evt, "size", fl_value_new_int(AV_MEDIA_PLAYER_TAP_HEADER + frame->size));
+	fl_value_set_string_take(evt, "pts", fl_value_new_int(frame->pts));
+	fl_value_set_string_take(evt, "width", fl_value_new_int(frame->width));
+	fl_value_set_string_take(evt, "height", fl_value_new_int(frame->height));
+	fl_value_set_string_take(evt, "format", fl_value_new_int(frame->format));
+	fl_value_set_string_take(evt, "sequence", fl_value_new_int((int64_t)sequence));
+	return fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+}
+
+static gboolean av_media_player_tap_poll(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (self && !self->snapshotTimer) {
+		self->snapshotTimer = g_timeout_add(5, av_media_player_snapshot_tick, id);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_tap_render(AvMediaPlayer* self, const GLuint texture, const int64_t pts) {
+	g_mutex_lock(&self->clipMutex);
+	if (self->tap) {
+		const bool pending = av_media_player_tap_update(self->tap, texture, self->width, self->height, pts);
+		if (pending && !self->tapPending) {
+			// frames are not rendered while paused, so the last ones would never be read back
+			g_idle_add(av_media_player_tap_poll, (gpointer)self->id);
+		}
+		self->tapPending = pending;
+	}
+	g_mutex_unlock(&self->clipMutex);
+}
+
+static void av_media_player_set_frame_tap(AvMediaPlayer* self, const double frameRate, const uint16_t maxSize, const uint32_t format) {
+	g_mutex_lock(&self->clipMutex);
+	if (self->tap) {
+		// its gl objects are deleted in the render thread by av_media_player_delete_stale
+		av_media_player_tap_close(self->tap);
+		g_ptr_array_add(self->staleTaps, self->tap);
+		av_media_player_mark(self);
+	}
+	self->tap = frameRate > 0 ? av_media_player_tap_new(self->id, format, maxSize, frameRate, av_media_player_tap_done) : NULL;
+	self->tapPending = false;
+	g_mutex_unlock(&self->clipMutex);
+}
+
+static void av_media_player_abr_stop(AvMediaPlayer* self);
+
+static void av_media_player_live_set_rate(AvMediaPlayer* self, double rate);
+
 static void av_media_player_close(AvMediaPlayer* self) {
+	self->timeshifted = false;
+	if (self->reconnectTimer) {
+		g_source_remove(self->reconnectTimer);
+		self->reconnectTimer = 0;
+	}
+	if (self->reconnecting) {
+		self->reconnecting = false;
+		mpv_set_property_string(self->mpv, "start", "none");
+	}
+	self->reconnectAttempts = 0;
+	if (self->trickTimer) {
+		g_source_remove(self->trickTimer);
+		self->trickTimer = 0;
+	}
+	self->trickRate = 0;
+	av_media_player_step_reset(self);
+	av_media_player_clip_release(self);
+	av_media_player_abr_stop(self);
+	self->abrTrack = 0;
+	av_media_player_live_set_rate(self, 1);
 	self->state = 0;
 	self->width = 0;
 	self->height = 0;
+	self->subtitleFile = NULL;
+	g_ptr_array_set_size(self->subtitleFiles, 0);
+	av_media_player_subtitle_file_flush(self, false);
+	av_media_player_set_sub_text(self, NULL);
 	self->position = 0;
 	self->bufferPosition = 0;
+	g_mutex_lock(&self->clipMutex);
+	self->framePts = -1;
+	self->framePtsMissed = false;
+	g_mutex_unlock(&self->clipMutex);
+	g_array_set_size(self->cacheRanges, 0);
 	self->overrideVideo = 0;
 	self->overrideAudio = 0;
 	self->overrideSubtitle = 0;
+	self->loopBegin = 0;
+	self->loopEnd = 0;
+	self->seeking = false;
+	self->wrapFrom = -1;
+	self->scrubTarget = -1;
+	self->scrubPending = false;
+	self->pendingSeek = -1;
+	self->pendingPlay = false;
+	av_media_player_drop_pending_step(self);
+	if (self->infoIdentity) {
+		g_free(self->infoIdentity);
+		self->infoIdentity = NULL;
+	}
+	if (self->cachedInfo) {
+		fl_value_unref(self->cachedInfo);
+		self->cachedInfo = NULL;
+	}
 	if (self->source) {
 		g_free(self->source);
 		self->source = NULL;
@@ -118,66 +1693,574 @@ static void av_media_player_close(AvMediaPlayer* self) {
 	mpv_command(self->mpv, stop);
 	const gchar* clear[] = { "playlist-clear", NULL };
 	mpv_command(self->mpv, clear);
+	av_media_player_apply_loop(self);
 }
 
-static void av_media_player_open(AvMediaPlayer* self, const gchar* source) {
-	av_media_player_close(self);
-	int result;
-	if (g_str_has_prefix(source, "asset://")) {
-		g_autoptr(FlDartProject) project = fl_dart_project_new();
-		gchar* path = g_strdup_printf("%s%s", fl_dart_project_get_assets_path(project), &source[7]);
-		const gchar* cmd[] = { "loadfile", path, NULL };
-		result = mpv_command(self->mpv, cmd);
-		g_free(path);
-	} else {
-		const gchar* cmd[] = { "loadfile", source, NULL };
-		result = mpv_command(self->mpv, cmd);
+#define AV_MEDIA_PLAYER_PROBE_SIZE 5000000 // default of libavformat, mpv rejects 0 although it starts with it
+
+static int av_media_player_set_probe(AvMediaPlayer* self, int64_t probeSize, int64_t analyzeDuration, const gchar* probeInfo, const gchar* format) {
+	// applies to the next open, 0 and NULL restore the defaults of mpv and libavformat
+	// returns the first error of mpv, the defaults are restored in that case
+	gchar* value = g_strdup_printf("%" G_GINT64_FORMAT, probeSize > 0 ? probeSize : AV_MEDIA_PLAYER_PROBE_SIZE);
+	int result = mpv_set_property_string(self->mpv, "demuxer-lavf-probesize", value);
+	g_free(value);
+	value = g_strdup_printf("%lf", (double)analyzeDuration / 1000);
+	int error = mpv_set_property_string(self->mpv, "demuxer-lavf-analyzeduration", value);
+	g_free(value);
+	if (result == 0) {
+		result = error;
+	}
+	error = mpv_set_property_string(self->mpv, "demuxer-lavf-probe-info", probeInfo ? probeInfo : "auto");
+	if (result == 0) {
+		result = error;
+	}
+	error = mpv_set_property_string(self->mpv, "demuxer-lavf-format", format ? format : "");
+	if (result == 0) {
+		result = error;
+	}
+	if (result < 0 && (probeSize || analyzeDuration || probeInfo || format)) {
+		av_media_player_set_probe(self, 0, 0, NULL, NULL);
 	}
+	return result;
+}
+
+static void av_media_player_open(AvMediaPlayer* self, const gchar* source, const int64_t clipMaxDuration, const uint16_t clipMaxWidth, const uint16_t clipMaxHeight, const uint16_t clipFrameWidth, const uint16_t clipFrameHeight) {
+	av_media_player_close(self);
+	self->clipMaxDuration = clipMaxDuration;
+	self->clipMaxWidth = clipMaxWidth;
+	self->clipMaxHeight = clipMaxHeight;
+	self->clipFrameWidth = clipFrameWidth;
+	self->clipFrameHeight = clipFrameHeight;
+	gchar* path = resolve_source(source);
+	g_autofree gchar* proxied = av_media_player_proxy_rewrite(path);
+	const gchar* cmd[] = { "loadfile", proxied ? proxied : path, NULL };
+	self->openTime = g_get_monotonic_time();
+	int result = mpv_command(self->mpv, cmd);
 	if (result == 0) {
 		self->state = 1;
 		self->source = g_strdup(source);
 		av_media_player_set_pause(self, TRUE);
+		self->infoIdentity = media_info_identity(path);
+		self->cachedInfo = self->infoIdentity ? media_info_load(self->infoIdentity) : media_info_from_pack(path);
+		if (self->cachedInfo) {
+			// report the cached info right away, it is validated once mpv has loaded the media
+			g_autoptr(FlValue) evt = fl_value_new_map();
+			fl_value_set_string_take(evt, "event", fl_value_new_string("mediaInfo"));
+			fl_value_set_string_take(evt, "source", fl_value_new_string(source));
+			fl_value_set_string(evt, "duration", fl_value_lookup_string(self->cachedInfo, "duration"));
+			fl_value_set_string(evt, "tracks", fl_value_lookup_string(self->cachedInfo, "tracks"));
+			fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+		}
 	} else {
 		g_autoptr(FlValue) evt = fl_value_new_map();
 		fl_value_set_string_take(evt, "event", fl_value_new_string("error"));
-		fl_value_set_string_take(evt, "event", fl_value_new_string(mpv_error_string(result)));
+		fl_value_set_string_take(evt, "value", fl_value_new_string(mpv_error_string(result)));
 		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
 	}
+	g_free(path);
+}
+
+/* reconnect, the media is reloaded where it failed, and the known tracks and overrides are kept */
+static gboolean av_media_player_reconnect_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (self) {
+		self->reconnectTimer = 0;
+		gchar* path = resolve_source(self->source);
+		g_autofree gchar* proxied = av_media_player_proxy_rewrite(path);
+		const gchar* cmd[] = { "loadfile", proxied ? proxied : path, NULL };
+		int result = mpv_command(self->mpv, cmd);
+		g_free(path);
+		if (result != 0) {
+			av_media_player_close(self);
+			g_autoptr(FlValue) evt = fl_value_new_map();
+			fl_value_set_string_take(evt, "event", fl_value_new_string("error"));
+			fl_value_set_string_take(evt, "value", fl_value_new_string(mpv_error_string(result)));
+			fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+		}
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static bool av_media_player_reconnect(AvMediaPlayer* self) {
+	// returns false if the error should be reported instead
+	if (self->reconnectAttempts >= self->reconnectMax || !(self->reconnecting || (self->state > 1 && self->networking))) {
+		return false;
+	}
+	if (!self->reconnecting) {
+		// resume from the last reported position, the playback position is gone once the file has ended,
+		// live streams resume at the live edge
+		if (!self->streaming) {
+			gchar* start = g_strdup_printf("%lf", (double)self->position / 1000);
+			mpv_set_property_string(self->mpv, "start", start);
+			g_free(start);
+		}
+		self->pendingPlay = self->state > 2;
+		self->reconnecting = true;
+		av_media_player_clip_release(self);
+		av_media_player_abr_stop(self);
+		self->state = 1;
+		self->seeking = false;
+	}
+	int64_t delay = MIN(self->reconnectDelay << MIN(self->reconnectAttempts, 16), self->reconnectMaxDelay);
+	// spread reconnects of many players to the same server
+	delay += g_random_int_range(0, (gint32)(delay / 4 + 1));
+	self->reconnectAttempts++;
+	self->reconnectTimer = g_timeout_add((guint)delay, av_media_player_reconnect_tick, (gpointer)self->id);
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("reconnecting"));
+	fl_value_set_string_take(evt, "attempt", fl_value_new_int(self->reconnectAttempts));
+	fl_value_set_string_take(evt, "delay", fl_value_new_int(delay));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	return true;
+}
+
+static void av_media_player_set_reconnect(AvMediaPlayer* self, int maxAttempts, int64_t delay, int64_t maxDelay) {
+	self->reconnectMax = maxAttempts;
+	self->reconnectDelay = MAX(delay, 1);
+	self->reconnectMaxDelay = MAX(maxDelay, self->reconnectDelay);
+}
+
+/* timeshift, live streams are cached in a temporary file and mpv drops packets older than demuxer-max-back-bytes */
+static void av_media_player_set_timeshift(AvMediaPlayer* self, int64_t maxBytes) {
+	// only applies to the next open
+	self->timeshift = maxBytes;
+	if (maxBytes > 0) {
+		gchar* dir = g_build_filename(g_get_user_cache_dir(), "av_media_player", "timeshift", NULL);
+		g_mkdir_with_parents(dir, 0755);
+		mpv_set_property_string(self->mpv, "demuxer-cache-dir", dir);
+		g_free(dir);
+		mpv_set_property_string(self->mpv, "cache", "yes");
+		mpv_set_property_string(self->mpv, "cache-on-disk", "yes");
+		mpv_set_property(self->mpv, "demuxer-max-back-bytes", MPV_FORMAT_INT64, &maxBytes);
+	} else {
+		mpv_set_property_string(self->mpv, "cache", "auto");
+		mpv_set_property_string(self->mpv, "cache-on-disk", "no");
+		mpv_set_property_string(self->mpv, "demuxer-max-back-bytes", "50MiB");
+	}
+}
+
+static void av_media_player_send_timeshift(AvMediaPlayer* self) {
+	// the seekable range around the playback position, in the timestamps of the stream like the position
+	int64_t pos = av_media_player_get_pos(self);
+	int64_t* range = NULL;
+	for (uint i = 0; i < self->cacheRanges->len / 2; i++) {
+		int64_t* r = &g_array_index(self->cacheRanges, int64_t, i * 2);
+		if (!range || (r[0] <= pos && r[1] >= pos)) {
+			range = r;
+		}
+	}
+	if (range) {
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("timeshift"));
+		fl_value_set_string_take(evt, "begin", fl_value_new_int(range[0]));
+		fl_value_set_string_take(evt, "end", fl_value_new_int(range[1]));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	}
+}
+
+/* demuxer cache */
+static bool av_media_player_is_cached(AvMediaPlayer* self, int64_t position) {
+	for (uint i = 0; i < self->cacheRanges->len / 2; i++) {
+		int64_t* range = &g_array_index(self->cacheRanges, int64_t, i * 2);
+		if (range[0] <= position && range[1] >= position) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void av_media_player_update_cache(AvMediaPlayer* self, mpv_node* node) {
+	// the demuxer may hold several disjoint ranges after seeks, all of them are served without downloading again
+	int64_t fwBytes = 0;
+	int64_t totalBytes = 0;
+	double cacheEnd = 0;
+	g_array_set_size(self->cacheRanges, 0);
+	for (int i = 0; node->format == MPV_FORMAT_NODE_MAP && i < node->u.list->num; i++) {
+		const char* key = node->u.list->keys[i];
+		mpv_node* value = &node->u.list->values[i];
+		if (g_str_equal(key, "cache-end") && value->format == MPV_FORMAT_DOUBLE) {
+			cacheEnd = value->u.double_;
+		} else if (g_str_equal(key, "fw-bytes") && value->format == MPV_FORMAT_INT64) {
+			fwBytes = value->u.int64;
+		} else if (g_str_equal(key, "total-bytes") && value->format == MPV_FORMAT_INT64) {
+			totalBytes = value->u.int64;
+		} else if (g_str_equal(key, "seekable-ranges") && value->format == MPV_FORMAT_NODE_ARRAY) {
+			for (int j = 0; j < value->u.list->num; j++) {
+				mpv_node* range = &value->u.list->values[j];
+				int64_t r[] = { -1, -1 };
+				for (int k = 0; range->format == MPV_FORMAT_NODE_MAP && k < range->u.list->num; k++) {
+					if (range->u.list->values[k].format != MPV_FORMAT_DOUBLE) {
+						continue;
+					} else if (g_str_equal(range->u.list->keys[k], "start")) {
+						r[0] = (int64_t)(range->u.list->values[k].u.double_ * 1000);
+					} else if (g_str_equal(range->u.list->keys[k], "end")) {
+						r[1] = (int64_t)(range->u.list->values[k].u.double_ * 1000);
+					}
+				}
+				if (r[0] >= 0 && r[1] >= r[0]) {
+					g_array_append_vals(self->cacheRanges, r, 2);
+				}
+			}
+		}
+	}
+	self->bufferPosition = (int64_t)(cacheEnd * 1000);
+	FlValue* ranges = fl_value_new_list();
+	for (uint i = 0; i < self->cacheRanges->len / 2; i++) {
+		int64_t* range = &g_array_index(self->cacheRanges, int64_t, i * 2);
+		FlValue* item = fl_value_new_map();
+		fl_value_set_string_take(item, "begin", fl_value_new_int(range[0]));
+		fl_value_set_string_take(item, "end", fl_value_new_int(range[1]));
+		fl_value_append_take(ranges, item);
+	}
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("buffer"));
+	fl_value_set_string_take(evt, "begin", fl_value_new_int(av_media_player_get_pos(self)));
+	fl_value_set_string_take(evt, "end", fl_value_new_int(self->bufferPosition));
+	fl_value_set_string_take(evt, "ranges", ranges);
+	fl_value_set_string_take(evt, "bytes", fl_value_new_int(fwBytes));
+	fl_value_set_string_take(evt, "totalBytes", fl_value_new_int(totalBytes));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	if (self->streaming && self->timeshift > 0) {
+		av_media_player_send_timeshift(self);
+	}
+}
+
+/* trick play, mpv stays paused and a timer steps keyframe seeks along a clock running at the trick rate */
+#define AV_MEDIA_PLAYER_TRICK_INTERVAL 100 // milliseconds between two steps
+
+static void av_media_player_send_trick_play(AvMediaPlayer* self) {
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("trickPlay"));
+	fl_value_set_string_take(evt, "value", fl_value_new_float(self->trickRate));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+}
+
+static void av_media_player_trick_stop(AvMediaPlayer* self) {
+	if (self->trickTimer) {
+		g_source_remove(self->trickTimer);
+		self->trickTimer = 0;
+		self->trickRate = 0;
+		if (self->state > 2) {
+			av_media_player_set_pause(self, FALSE);
+		}
+		av_media_player_send_trick_play(self);
+	}
+}
+
+static gboolean av_media_player_trick_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self) {
+		return G_SOURCE_REMOVE;
+	} else if (self->seeking) {
+		// the previous keyframe is not shown yet, skip this step so at most one seek is decoded at a time
+		return G_SOURCE_CONTINUE;
+	}
+	double duration;
+	mpv_get_property(self->mpv, "duration/full", MPV_FORMAT_DOUBLE, &duration);
+	const int64_t end = (int64_t)(duration * 1000);
+	const int64_t target = self->trickBase + (int64_t)((g_get_monotonic_time() - self->trickBaseTime) / 1000 * self->trickRate);
+	av_media_player_seek(self, CLAMP(target, 0, end), "absolute+keyframes");
+	if (target <= 0 || target >= end) {
+		av_media_player_trick_stop(self);
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static void av_media_player_set_trick_play(AvMediaPlayer* self, const double rate) {
+	if (rate == 0) {
+		av_media_player_trick_stop(self);
+	} else if (self->state < 2 || self->streaming || self->clipState == 2) {
+		// needs a seekable media which is decoded by mpv
+		self->trickRate = 0;
+		av_media_player_send_trick_play(self);
+	} else {
+		if (self->clipState > 0) {
+			av_media_player_clip_release(self);
+		}
+		av_media_player_step_reset(self);
+		if (!self->trickTimer) {
+			// paused, so no audio is played and only the keyframes of the seeks are decoded
+			av_media_player_set_pause(self, TRUE);
+			self->trickTimer = g_timeout_add(AV_MEDIA_PLAYER_TRICK_INTERVAL, av_media_player_trick_tick, (gpointer)self->id);
+		}
+		self->trickRate = rate;
+		self->trickBase = self->position;
+		self->trickBaseTime = g_get_monotonic_time();
+	}
+}
+
+static void av_media_player_play(AvMediaPlayer* self) {
+	av_media_player_trick_stop(self);
+	av_media_player_step_reset(self);
+	if (self->state == 2 && self->clipState == 2) {
+		int64_t pos = av_media_player_clip_pos(self);
+		av_media_player_clip_set_clock(self, pos >= self->clipDuration ? 0 : pos);
+		self->state = 3;
+		av_media_player_clip_start(self);
+	} else if (self->state == 2) {
+		self->state = 3;
+		if (av_media_player_is_eof(self)) {
+			av_media_player_rewind(self);
+		}
+		av_media_player_set_pause(self, FALSE);
+	} else if (self->state == 1 && (self->cachedInfo || self->reconnecting)) {
+		self->pendingPlay = true;
+	}
+}
+
+static void av_media_player_pause(AvMediaPlayer* self) {
+	if (self->state > 2 && self->clipState == 2) {
+		av_media_player_clip_set_clock(self, av_media_player_clip_pos(self));
+		self->state = 2;
+	} else if (self->state > 2) {
+		self->state = 2;
+		av_media_player_set_pause(self, TRUE);
+		if (self->streaming && self->timeshift > 0) {
+			self->timeshifted = true;
+		}
+	} else {
+		self->pendingPlay = false;
+	}
+	av_media_player_trick_stop(self);
+}
+
+static void av_media_player_seek_to(AvMediaPlayer* self, const int64_t position) {
+	av_media_player_trick_stop(self);
+	av_media_player_step_reset(self);
+	if (self->clipState == 2) {
+		av_media_player_clip_set_clock(self, position);
+		self->position = position;
+		av_media_player_send_position(self);
+		av_media_player_mark(self);
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+		return;
+	} else if (self->clipState > 0) {
+		// a partial capture is useless once playback jumps, fall back to normal playback
+		av_media_player_clip_release(self);
+	}
+	if (self->state == 1 && (self->cachedInfo || self->reconnecting)) {
+		// seekEnd is sent once the seek is really done after loading
+		self->pendingSeek = position;
+	} else if (self->state < 2 || (self->streaming && self->timeshift == 0) || av_media_player_get_pos(self) == position) {
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	} else if (self->scrubbing) {
+		self->seekCached = av_media_player_is_cached(self, position);
+		// only the latest target matters while scrubbing, so never queue more than one seek in mpv
+		self->scrubTarget = position;
+		if (self->seeking) {
+			self->scrubPending = true;
+		} else {
+			av_media_player_seek(self, position, "absolute+keyframes");
+		}
+	} else if (self->state > 1) {
+		self->seekCached = av_media_player_is_cached(self, position);
+		if (self->streaming) {
+			self->timeshifted = true;
+		}
+		av_media_player_seek(self, position, "absolute");
+	}
+}
+
+static void av_media_player_step_frame(AvMediaPlayer* self, const int direction, FlMethodCall* call) {
+	if (self->state == 1 && self->cachedInfo && !self->pendingStepCall) {
+		// dart already knows the media, step once it is loaded
+		self->pendingStepCall = g_object_ref(call);
+		self->pendingStep = direction > 0 ? 1 : -1;
+		return;
+	}
+	if (self->stepCall || self->stepState > 0 || self->state < 2 || self->streaming || self->clipState == 2) {
+		// one step at a time, and only for seekable media which is decoded by mpv
+		fl_method_call_respond_success(call, NULL, NULL);
+		return;
+	}
+	av_media_player_pause(self);
+	if (self->clipState > 0) {
+		av_media_player_clip_release(self);
+	}
+	self->stepCall = g_object_ref(call);
+	const int64_t pos = av_media_player_get_pos(self);
+	int64_t pts = -1;
+	g_mutex_lock(&self->clipMutex);
+	GArray* frames = self->stepFrames;
+	// the cache can only be extended while mpv is at its newest frame
+	const bool current = frames->len > 0 && g_array_index(frames, AvMediaPlayerClipFrame, frames->len - 1).pts == pos;
+	if (direction > 0) {
+		if (self->stepIndex >= 0 && self->stepIndex + 1 < (int)frames->len) {
+			self->stepIndex++;
+			pts = g_array_index(frames, AvMediaPlayerClipFrame, self->stepIndex).pts;
+			if (self->stepIndex == (int)frames->len - 1 && current) {
+				self->stepIndex = -1; // mpv shows the same frame
+			}
+		} else {
+			if (!current) {
+				av_media_player_step_clear(self);
+			}
+			self->stepIndex = -1;
+			self->stepLast = pos;
+		}
+	} else {
+		int index = self->stepIndex >= 0 ? self->stepIndex : current ? (int)frames->len - 1 : -1;
+		if (index > 0) {
+			self->stepIndex = index - 1;
+			pts = g_array_index(frames, AvMediaPlayerClipFrame, self->stepIndex).pts;
+		} else if (index == 0) {
+			// the oldest cached frame is shown, keep it and continue decoding before it
+			for (uint i = 1; i < frames->len; i++) {
+				g_array_append_val(self->staleTextures, g_array_index(frames, AvMediaPlayerClipFrame, i).texture);
+			}
+			g_array_set_size(frames, 1);
+			self->stepMemory = (int64_t)self->fbo.w * self->fbo.h * 4;
+			self->stepIndex = -1;
+			self->stepTarget = g_array_index(frames, AvMediaPlayerClipFrame, 0).pts;
+			self->stepLast = self->stepTarget == pos ? -1 : pos;
+		} else {
+			av_media_player_step_clear(self);
+			self->stepTarget = pos;
+			self->stepLast = -1;
+		}
+	}
+	g_mutex_unlock(&self->clipMutex);
+	if (pts >= 0) {
+		av_media_player_mark(self);
+		av_media_player_step_respond(self, pts);
+	} else if (direction > 0) {
+		const gchar* cmd[] = { "frame-step", NULL };
+		if (av_media_player_is_eof(self) || mpv_command(self->mpv, cmd) < 0) {
+			av_media_player_step_respond(self, pos);
+		} else {
+			self->stepState = 1;
+		}
+	} else if (self->stepTarget != pos) {
+		self->stepState = 2;
+		av_media_player_seek(self, self->stepTarget - 1, "absolute+keyframes");
+	} else {
+		int64_t frame = 0;
+		mpv_get_property(self->mpv, "estimated-frame-number", MPV_FORMAT_INT64, &frame);
+		if (frame <= 0) {
+			av_media_player_step_respond(self, pos);
+		} else {
+			// cache the shown frame first, the frames before it are decoded next
+			self->stepState = 3;
+			av_media_player_mark(self);
+		}
+	}
 }
 
-static void av_media_player_play(AvMediaPlayer* self) {
-	if (self->state == 2) {
-		self->state = 3;
-		if (av_media_player_is_eof(self)) {
-			av_media_player_rewind(self);
+static void av_media_player_set_scrubbing(AvMediaPlayer* self, const bool scrubbing) {
+	if (self->scrubbing != scrubbing) {
+		self->scrubbing = scrubbing;
+		if (!scrubbing) {
+			// finish with one exact seek to wherever the user released
+			if (self->pendingSeek >= 0) {
+				// the media is still loading, the pending seek is exact and sends seekEnd itself
+			} else if (self->scrubTarget >= 0 && self->seeking) {
+				self->scrubPending = true;
+			} else if (self->scrubTarget >= 0 && self->state > 1 && (!self->streaming || self->timeshift > 0) && self->clipState < 2) {
+				av_media_player_seek(self, self->scrubTarget, "absolute");
+				self->scrubTarget = -1;
+			} else {
+				self->scrubTarget = -1;
+				g_autoptr(FlValue) evt = fl_value_new_map();
+				fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
+				fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+			}
 		}
-		av_media_player_set_pause(self, FALSE);
 	}
 }
 
-static void av_media_player_pause(AvMediaPlayer* self) {
-	if (self->state > 2) {
-		self->state = 2;
-		av_media_player_set_pause(self, TRUE);
+static void av_media_player_set_speed(AvMediaPlayer* self, const double speed) {
+	if (self->clipState == 2) {
+		av_media_player_clip_set_clock(self, av_media_player_clip_pos(self));
 	}
+	self->speed = speed;
+	double value = speed * self->liveRate;
+	mpv_set_property(self->mpv, "speed", MPV_FORMAT_DOUBLE, &value);
 }
 
-static void av_media_player_seek_to(AvMediaPlayer* self, const int64_t position) {
-	if (self->state < 2 || self->streaming || av_media_player_get_pos(self) == position) {
-		g_autoptr(FlValue) evt = fl_value_new_map();
-		fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
-		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
-	} else if (self->state > 1) {
-		gchar* t = g_strdup_printf("%lf", (double)position / 1000);
-		const gchar* cmd[] = { "seek", t, "absolute", NULL };
-		mpv_command(self->mpv, cmd);
-		g_free(t);
+/* low latency live, the latency is the distance between the playback position and the live edge,
+ * which is the end of the seekable cache since the demuxer is allowed to read everything the stream offers */
+static void av_media_player_live_set_rate(AvMediaPlayer* self, double rate) {
+	if (self->liveRate != rate) {
+		self->liveRate = rate;
+		av_media_player_set_speed(self, self->speed);
 	}
 }
 
-static void av_media_player_set_speed(AvMediaPlayer* self, const double speed) {
-	self->speed = speed;
-	mpv_set_property(self->mpv, "speed", MPV_FORMAT_DOUBLE, &self->speed);
+static gboolean av_media_player_live_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self) {
+		return G_SOURCE_REMOVE;
+	}
+	double pos, end;
+	gboolean stalled = FALSE;
+	mpv_get_property(self->mpv, "paused-for-cache", MPV_FORMAT_FLAG, &stalled);
+	if (self->state < 3 || !self->streaming || self->seeking || stalled ||
+		mpv_get_property(self->mpv, "time-pos", MPV_FORMAT_DOUBLE, &pos) < 0 ||
+		mpv_get_property(self->mpv, "demuxer-cache-time", MPV_FORMAT_DOUBLE, &end) < 0) {
+		av_media_player_live_set_rate(self, 1);
+		return G_SOURCE_CONTINUE;
+	}
+	if (self->cacheRanges->len > 0) {
+		// the newest seekable range ends at the live edge, demuxer-cache-time may be in an older range after a seek
+		end = MAX(end, g_array_index(self->cacheRanges, int64_t, self->cacheRanges->len - 1) / 1000.0);
+	}
+	int64_t latency = (int64_t)((end - pos) * 1000);
+	if (self->timeshifted && latency > self->liveMaxLatency) {
+		// stay wherever the user went back to, until playback is close to the live edge again
+		av_media_player_live_set_rate(self, 1);
+	} else if (latency > self->liveMaxLatency) {
+		// too far behind to catch up smoothly, e.g. after a long stall or pause
+		av_media_player_live_set_rate(self, 1);
+		av_media_player_seek(self, (int64_t)(end * 1000) - self->liveTarget, "absolute");
+	} else {
+		self->timeshifted = false;
+		// catch up within about 10 seconds, and ignore small errors so the speed doesn't wobble
+		int64_t error = latency - self->liveTarget;
+		double rate = 1;
+		if (ABS(error) > MAX(self->liveTarget / 10, 100)) {
+			rate = 1 + CLAMP(error / 10000.0, -self->liveMaxRate, self->liveMaxRate);
+		}
+		av_media_player_live_set_rate(self, rate);
+	}
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("latency"));
+	fl_value_set_string_take(evt, "value", fl_value_new_int(latency));
+	fl_value_set_string_take(evt, "rate", fl_value_new_float(self->liveRate));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	return G_SOURCE_CONTINUE;
+}
+
+static void av_media_player_set_low_latency(AvMediaPlayer* self, int64_t target, int64_t maxLatency, double maxRate) {
+	self->liveTarget = target;
+	self->liveMaxLatency = MAX(maxLatency, target);
+	self->liveMaxRate = maxRate;
+	if (target > 0) {
+		// start near the live edge and resume from a stall as soon as a little is buffered,
+		// hls options only apply to the next open. the readahead goes well past maxLatency,
+		// so the cache reaches the live edge and measures the latency instead of the readahead limit
+		gchar* readahead = g_strdup_printf("%lf", MAX(self->liveMaxLatency * 2, 1000) / 1000.0);
+		mpv_set_property_string(self->mpv, "demuxer-readahead-secs", readahead);
+		g_free(readahead);
+		mpv_set_property_string(self->mpv, "cache-pause-wait", "0.2");
+		mpv_set_property_string(self->mpv, "demuxer-lavf-o", "live_start_index=-1");
+		if (!self->liveTimer) {
+			self->liveTimer = g_timeout_add(500, av_media_player_live_tick, (gpointer)self->id);
+		}
+	} else {
+		mpv_set_property_string(self->mpv, "demuxer-readahead-secs", "1");
+		mpv_set_property_string(self->mpv, "cache-pause-wait", "1");
+		mpv_set_property_string(self->mpv, "demuxer-lavf-o", "");
+		if (self->liveTimer) {
+			g_source_remove(self->liveTimer);
+			self->liveTimer = 0;
+		}
+		av_media_player_live_set_rate(self, 1);
+	}
 }
 
 static void av_media_player_set_volume(AvMediaPlayer* self, const double volume) {
@@ -187,10 +2270,30 @@ static void av_media_player_set_volume(AvMediaPlayer* self, const double volume)
 
 static void av_media_player_set_looping(AvMediaPlayer* self, const bool looping) {
 	self->looping = looping;
+	if (self->state > 1) {
+		av_media_player_apply_loop(self);
+	}
+}
+
+static void av_media_player_set_loop_range(AvMediaPlayer* self, const int64_t begin, const int64_t end) {
+	if (self->state > 1 || (self->state == 1 && self->cachedInfo)) {
+		// applied once the media is loaded if dart already knows it from the cache
+		self->loopBegin = begin;
+		self->loopEnd = end;
+	}
+	if (self->state > 1) {
+		av_media_player_apply_loop(self);
+	}
 }
 
 static void av_media_player_set_show_subtitle(AvMediaPlayer* self, const bool show) {
-	mpv_set_property_string(self->mpv, "sub-visibility", show ? "yes" : "no");
+	if (self->showSubtitle != show) {
+		self->showSubtitle = show;
+		mpv_set_property_string(self->mpv, "sub-visibility", show && !self->subOverlay ? "yes" : "no");
+		if (self->subText) {
+			av_media_player_render_subtitle(self);
+		}
+	}
 }
 
 static void av_media_player_set_preferred_audio_language(AvMediaPlayer* self, const gchar* language) {
@@ -201,26 +2304,193 @@ static void av_media_player_set_preferred_subtitle_language(AvMediaPlayer* self,
 	mpv_set_property_string(self->mpv, "slang", language);
 }
 
+/* adaptive bitrate, hls variants are exposed by mpv as video tracks with a bitrate */
+static bool av_media_player_abr_allowed(AvMediaPlayer* self, AvMediaPlayerVideoTrack* track) {
+	return track->bitrate > 0 &&
+		(self->maxBitRate == 0 || track->bitrate <= self->maxBitRate) &&
+		(self->maxWidth == 0 || track->width <= self->maxWidth) &&
+		(self->maxHeight == 0 || track->height <= self->maxHeight);
+}
+
+static bool av_media_player_abr_active(AvMediaPlayer* self) {
+	if (!self->abr || !self->networking || self->state < 2 || self->overrideVideo != 0) {
+		return false;
+	}
+	uint count = 0;
+	for (uint i = 0; i < self->videoTracks->len; i++) {
+		if (g_array_index(self->videoTracks, AvMediaPlayerVideoTrack, i).bitrate > 0) {
+			count++;
+		}
+	}
+	return count > 1;
+}
+
+static AvMediaPlayerVideoTrack* av_media_player_abr_pick(AvMediaPlayer* self, double budget) {
+	// the variant with the highest bitrate within budget, or the lowest allowed one if none fits
+	AvMediaPlayerVideoTrack* best = NULL;
+	AvMediaPlayerVideoTrack* lowest = NULL;
+	for (uint i = 0; i < self->videoTracks->len; i++) {
+		AvMediaPlayerVideoTrack* track = &g_array_index(self->videoTracks, AvMediaPlayerVideoTrack, i);
+		if (av_media_player_abr_allowed(self, track)) {
+			if (track->bitrate <= budget && (!best || track->bitrate > best->bitrate)) {
+				best = track;
+			}
+			if (!lowest || track->bitrate < lowest->bitrate) {
+				lowest = track;
+			}
+		}
+	}
+	return best ? best : lowest;
+}
+
+static void av_media_player_abr_switch(AvMediaPlayer* self, AvMediaPlayerVideoTrack* track) {
+	char p[8];
+	sprintf(p, "%d", track->id);
+	mpv_set_property_string(self->mpv, "vid", p);
+	self->abrTrack = track->id;
+	self->abrSwitchTime = g_get_monotonic_time();
+	sprintf(p, "0.%d", track->id);
+	g_autoptr(FlValue) evt = fl_value_new_map();
+	fl_value_set_string_take(evt, "event", fl_value_new_string("variantSwitch"));
+	fl_value_set_string_take(evt, "trackId", fl_value_new_string(p));
+	fl_value_set_string_take(evt, "bitrate", fl_value_new_int(track->bitrate));
+	fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+}
+
+static void av_media_player_abr_update(AvMediaPlayer* self, double buffer) {
+	// buffer is the buffered duration in seconds
+	double estimate = MIN(self->abrFast, self->abrSlow);
+	AvMediaPlayerVideoTrack* current = NULL;
+	for (uint i = 0; i < self->videoTracks->len; i++) {
+		AvMediaPlayerVideoTrack* track = &g_array_index(self->videoTracks, AvMediaPlayerVideoTrack, i);
+		if (track->id == self->abrTrack) {
+			current = track;
+		}
+	}
+	AvMediaPlayerVideoTrack* target = av_media_player_abr_pick(self, estimate > 0 ? estimate * self->abrSafety : 0);
+	if (!target || target == current) {
+		return;
+	} else if (!current || !av_media_player_abr_allowed(self, current)) {
+		av_media_player_abr_switch(self, target);
+	} else if (estimate <= 0) {
+		return;
+	} else if (target->bitrate < current->bitrate) {
+		// the buffer drains while the current variant needs more than the bandwidth, switch before it runs dry
+		if (current->bitrate > estimate && buffer / (1 - estimate / current->bitrate) * 1000 < self->abrUpBuffer) {
+			av_media_player_abr_switch(self, target);
+		}
+	} else if (buffer * 1000 >= self->abrUpBuffer && g_get_monotonic_time() - self->abrSwitchTime >= self->abrInterval * 1000) {
+		av_media_player_abr_switch(self, target);
+	}
+}
+
+static gboolean av_media_player_abr_tick(void* id) {
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	if (!self) {
+		return G_SOURCE_REMOVE;
+	}
+	double buffer = 0;
+	int64_t rate = 0;
+	bool idle = false;
+	mpv_node node;
+	if (mpv_get_property(self->mpv, "demuxer-cache-state", MPV_FORMAT_NODE, &node) == 0) {
+		if (node.format == MPV_FORMAT_NODE_MAP) {
+			for (int i = 0; i < node.u.list->num; i++) {
+				mpv_node* value = &node.u.list->values[i];
+				if (g_str_equal(node.u.list->keys[i], "cache-duration") && value->format == MPV_FORMAT_DOUBLE) {
+					buffer = value->u.double_;
+				} else if (g_str_equal(node.u.list->keys[i], "raw-input-rate") && value->format == MPV_FORMAT_INT64) {
+					rate = value->u.int64;
+				} else if (g_str_equal(node.u.list->keys[i], "idle") && value->format == MPV_FORMAT_FLAG) {
+					idle = value->u.flag;
+				}
+			}
+		}
+		mpv_free_node_contents(&node);
+	}
+	// the input rate only tells the bandwidth while the demuxer is downloading, not when the cache is full
+	if (!idle && rate > 0) {
+		double sample = rate * 8.0;
+		// sampled every second, with half lives of 2 and 8 seconds
+		self->abrFast = self->abrFast > 0 ? self->abrFast * 0.707 + sample * 0.293 : sample;
+		self->abrSlow = self->abrSlow > 0 ? self->abrSlow * 0.917 + sample * 0.083 : sample;
+		plugin->bandwidth = MIN(self->abrFast, self->abrSlow);
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("bandwidth"));
+		fl_value_set_string_take(evt, "value", fl_value_new_int((int64_t)plugin->bandwidth));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	}
+	av_media_player_abr_update(self, buffer);
+	return G_SOURCE_CONTINUE;
+}
+
+static void av_media_player_abr_stop(AvMediaPlayer* self) {
+	if (self->abrTimer) {
+		g_source_remove(self->abrTimer);
+		self->abrTimer = 0;
+	}
+}
+
+static void av_media_player_abr_start(AvMediaPlayer* self) {
+	// starts from the latest estimate of any player, so the first variant is picked from a real measurement if possible
+	if (!self->abrTimer && av_media_player_abr_active(self)) {
+		int64_t vid;
+		if (self->abrTrack == 0 && mpv_get_property(self->mpv, "vid", MPV_FORMAT_INT64, &vid) == 0) {
+			self->abrTrack = (uint16_t)vid;
+		}
+		self->abrFast = plugin->bandwidth;
+		self->abrSlow = plugin->bandwidth;
+		av_media_player_abr_update(self, 0);
+		self->abrTimer = g_timeout_add(1000, av_media_player_abr_tick, (gpointer)self->id);
+	}
+}
+
+static void av_media_player_set_abr(AvMediaPlayer* self, bool enabled, double safety, int64_t upBuffer, int64_t interval) {
+	self->abr = enabled;
+	self->abrSafety = safety;
+	self->abrUpBuffer = upBuffer;
+	self->abrInterval = interval;
+	if (!av_media_player_abr_active(self)) {
+		av_media_player_abr_stop(self);
+	} else if (!self->abrTimer) {
+		av_media_player_abr_start(self);
+	}
+}
+
+static void av_media_player_set_max_resolution_real(AvMediaPlayer* self);
+
 static void av_media_player_set_max_bitrate(AvMediaPlayer* self, uint32_t bitrate) {
-	mpv_set_property(self->mpv, "hls-bitrate", MPV_FORMAT_INT64, &bitrate);
+	int64_t value = bitrate;
+	self->maxBitRate = bitrate;
+	mpv_set_property(self->mpv, "hls-bitrate", MPV_FORMAT_INT64, &value);
+	if (self->abrTimer) {
+		av_media_player_abr_update(self, 0);
+	}
 }
 
 static void av_media_player_set_max_resolution_real(AvMediaPlayer* self) {
-	if (self->overrideVideo == 0) {
+	if (self->abrTimer || av_media_player_abr_active(self)) {
+		// abr picks the variant within the limits
+		if (!self->abrTimer) {
+			av_media_player_abr_start(self);
+		} else {
+			av_media_player_abr_update(self, 0);
+		}
+	} else if (self->overrideVideo == 0) {
 		if (self->maxWidth > 0 || self->maxHeight > 0) {
 			uint16_t id = 0;
 			uint32_t maxRes = 0;
 			uint16_t minId = 0;
 			uint32_t minRes = UINT32_MAX;
 			for (uint i = 0; i < self->videoTracks->len; i++) {
-				uint16_t* data = &g_array_index(self->videoTracks, uint16_t, i * 3);
-				uint32_t res = data[1] * data[2];
-				if ((self->maxWidth == 0 || data[1] <= self->maxWidth) && (self->maxHeight == 0 || data[2] <= self->maxHeight) && res > maxRes) {
-					id = data[0];
+				AvMediaPlayerVideoTrack* track = &g_array_index(self->videoTracks, AvMediaPlayerVideoTrack, i);
+				uint32_t res = track->width * track->height;
+				if ((self->maxWidth == 0 || track->width <= self->maxWidth) && (self->maxHeight == 0 || track->height <= self->maxHeight) && res > maxRes) {
+					id = track->id;
 					maxRes = res;
 				}
 				if (id == 0 && res < minRes) {
-					minId = data[0];
+					minId = track->id;
 					minRes = res;
 				}
 			}
@@ -247,7 +2517,17 @@ static void av_media_player_set_max_resolution(AvMediaPlayer* self, const uint16
 }
 
 static void av_media_player_overrideTrack(AvMediaPlayer* self, const uint8_t typeId, uint16_t trackId, bool enabled) {
-	if (self->state > 1) {
+	if (self->state == 1 && (self->cachedInfo || self->reconnecting)) {
+		// applied once the media is loaded
+		uint16_t id = enabled ? trackId : 0;
+		if (typeId == 0) {
+			self->overrideVideo = id;
+		} else if (typeId == 1) {
+			self->overrideAudio = id;
+		} else if (typeId == 2) {
+			self->overrideSubtitle = id;
+		}
+	} else if (self->state > 1) {
 		char p[8];
 		if (enabled) {
 			sprintf(p, "%d", trackId);
@@ -257,13 +2537,21 @@ static void av_media_player_overrideTrack(AvMediaPlayer* self, const uint8_t typ
 		}
 		if (typeId == 0) {
 			self->overrideVideo = trackId;
-			mpv_set_property_string(self->mpv, "vid", p);
+			if (trackId) {
+				av_media_player_abr_stop(self);
+				mpv_set_property_string(self->mpv, "vid", p);
+			} else if (av_media_player_abr_active(self)) {
+				self->abrTrack = 0;
+				av_media_player_abr_start(self);
+			} else {
+				mpv_set_property_string(self->mpv, "vid", p);
+			}
 		} else if (typeId == 1) {
 			self->overrideAudio = trackId;
 			mpv_set_property_string(self->mpv, "aid", p);
 		} else if (typeId == 2) {
 			self->overrideSubtitle = trackId;
-			mpv_set_property_string(self->mpv, "sid", p);
+			mpv_set_property_string(self->mpv, "sid", av_media_player_select_subtitle_file(self, trackId) ? "no" : p);
 		}
 	}
 }
@@ -279,6 +2567,27 @@ static void* gl_init(void* data, const char* name) {
 	}
 }
 
+static void av_media_player_check_wrap(AvMediaPlayer* self) {
+	// a wrap jumps from the end of the file or loop range back to its start
+	const int64_t from = self->wrapFrom;
+	self->wrapFrom = -1;
+	double duration = 0;
+	mpv_get_property(self->mpv, "duration", MPV_FORMAT_DOUBLE, &duration);
+	const int64_t begin = self->loopEnd > self->loopBegin ? self->loopBegin : 0;
+	const int64_t end = self->loopEnd > self->loopBegin ? self->loopEnd : (int64_t)(duration * 1000);
+	const int64_t pos = av_media_player_get_pos(self);
+	if (from < end - 1000 || pos >= from || pos > begin + 1000) {
+		return;
+	}
+	self->position = pos;
+	av_media_player_send_position(self);
+	if (self->state > 2 && self->looping && self->loopEnd <= self->loopBegin) {
+		g_autoptr(FlValue) evt = fl_value_new_map();
+		fl_value_set_string_take(evt, "event", fl_value_new_string("finished"));
+		fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+	}
+}
+
 static gboolean event_callback(void* id) {
 	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
 	while (self) {
@@ -288,26 +2597,35 @@ static gboolean event_callback(void* id) {
 		} else if (self->state > 0) {
 			if (event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
 				mpv_event_property* detail = (mpv_event_property*)event->data;
-				if (detail->data) {
+				if (g_str_equal(detail->name, "sub-text")) {
+					if (!self->subtitleFile) {
+						av_media_player_set_sub_text(self, detail->format == MPV_FORMAT_STRING ? *(const gchar**)detail->data : NULL);
+					}
+				} else if (g_str_equal(detail->name, "current-tracks/sub/codec")) {
+					av_media_player_set_sub_codec(self, detail->format == MPV_FORMAT_STRING ? *(const gchar**)detail->data : NULL);
+				} else if (detail->data) {
 					if (g_str_equal(detail->name, "time-pos/full")) {
-						if (self->state > 1 && !self->streaming) {
+						g_mutex_lock(&self->clipMutex);
+						self->framePts = (int64_t)(*(double*)detail->data * 1000);
+						const bool missed = self->framePtsMissed;
+						self->framePtsMissed = false;
+						g_mutex_unlock(&self->clipMutex);
+						if (missed) {
+							av_media_player_mark(self);
+						}
+						if (self->subtitleFile) {
+							av_media_player_update_cue(self, (int64_t)(*(double*)detail->data * 1000));
+						}
+						if (self->state > 1 && (!self->streaming || self->timeshift > 0) && self->stepState < 2) {
 							int64_t pos = (int64_t)(*(double*)detail->data * 1000);
 							if (self->position != pos) {
 								self->position = pos;
-								g_autoptr(FlValue) evt = fl_value_new_map();
-								fl_value_set_string_take(evt, "event", fl_value_new_string("position"));
-								fl_value_set_string_take(evt, "value", fl_value_new_int(self->position));
-								fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+								av_media_player_send_position(self);
 							}
 						}
-					} else if (g_str_equal(detail->name, "demuxer-cache-time")) {
+					} else if (g_str_equal(detail->name, "demuxer-cache-state")) {
 						if (self->networking) {
-							self->bufferPosition = (int64_t)(*(double*)detail->data * 1000);
-							g_autoptr(FlValue) evt = fl_value_new_map();
-							fl_value_set_string_take(evt, "event", fl_value_new_string("buffer"));
-							fl_value_set_string_take(evt, "begin", fl_value_new_int(av_media_player_get_pos(self)));
-							fl_value_set_string_take(evt, "end", fl_value_new_int(self->bufferPosition));
-							fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+							av_media_player_update_cache(self, (mpv_node*)detail->data);
 						}
 					} else if (g_str_equal(detail->name, "paused-for-cache")) {
 						if (self->state > 2) {
@@ -320,11 +2638,11 @@ static gboolean event_callback(void* id) {
 						if (self->state > 2 && *(gboolean*)detail->data && av_media_player_is_eof(self)) {
 							if (self->streaming) {
 								av_media_player_close(self);
-							} else if (self->looping) {
-								av_media_player_rewind(self);
-								av_media_player_set_pause(self, FALSE);
 							} else {
 								self->state = 2;
+								if (self->clipState == 1) {
+									av_media_player_clip_finish((gpointer)self->id);
+								}
 							}
 							g_autoptr(FlValue) evt = fl_value_new_map();
 							fl_value_set_string_take(evt, "event", fl_value_new_string("finished"));
@@ -334,7 +2652,7 @@ static gboolean event_callback(void* id) {
 				}
 			} else if (event->event_id == MPV_EVENT_END_FILE) {
 				mpv_event_end_file* detail = (mpv_event_end_file*)event->data;
-				if (detail->reason == MPV_END_FILE_REASON_ERROR) {
+				if (detail->reason == MPV_END_FILE_REASON_ERROR && !av_media_player_reconnect(self)) {
 					av_media_player_close(self);
 					g_autoptr(FlValue) evt = fl_value_new_map();
 					fl_value_set_string_take(evt, "event", fl_value_new_string("error"));
@@ -345,184 +2663,729 @@ static gboolean event_callback(void* id) {
 				if (self->state == 1) {
 					double duration;
 					gboolean networking;
-					int64_t count;
-					mpv_get_property(self->mpv, "track-list/count", MPV_FORMAT_INT64, &count);
-					FlValue* tracks = fl_value_new_map();
-					for (uint i = 0; i < count; i++) {
-						FlValue* info = fl_value_new_map();
-						gchar* str;
-						gchar p[33];
-						sprintf(p, "track-list/%d/type", i);
-						mpv_get_property(self->mpv, p, MPV_FORMAT_STRING, &str);
-						fl_value_set_string_take(info, "type", fl_value_new_string(str));
-						uint8_t type = g_str_equal(str, "video") ? 0 : g_str_equal(str, "audio") ? 1 : 2;
-						mpv_free(str);
-						int64_t trackId;
-						sprintf(p, "track-list/%d/id", i);
-						mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &trackId);
-						int64_t size;
-						sprintf(p, "track-list/%d/lang", i);
-						if (!mpv_get_property(self->mpv, p, MPV_FORMAT_STRING, &str)) {
-							UErrorCode status = U_ZERO_ERROR;
-							char langtag[ULOC_FULLNAME_CAPACITY];
-							uloc_toLanguageTag(str, langtag, ULOC_FULLNAME_CAPACITY, FALSE, &status); // we don't want ISO 639-2 codes
-							fl_value_set_string_take(info, "language", fl_value_new_string(U_FAILURE(status) ? str : langtag));
-							mpv_free(str);
-						}
-						sprintf(p, "track-list/%d/title", i);
-						if (!mpv_get_property(self->mpv, p, MPV_FORMAT_STRING, &str)) {
-							fl_value_set_string_take(info, "label", fl_value_new_string(str));
-							mpv_free(str);
-						}
-						sprintf(p, "track-list/%d/hls-bitrate", i);
-						if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-							fl_value_set_string_take(info, "bitrate", fl_value_new_int(size));
-						} else {
-							sprintf(p, "track-list/%d/demux-bitrate", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-								fl_value_set_string_take(info, "bitrate", fl_value_new_int(size));
-							}
-						}
-						sprintf(p, "track-list/%d/codec", i);
-						if (!mpv_get_property(self->mpv, p, MPV_FORMAT_STRING, &str)) {
-							fl_value_set_string_take(info, "format", fl_value_new_string(str));
-							mpv_free(str);
-						} else {
-							sprintf(p, "track-list/%d/format-name", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_STRING, &str)) {
-								fl_value_set_string_take(info, "format", fl_value_new_string(str));
-								mpv_free(str);
-							}
-						}
-						if (type == 0) {
-							uint16_t data[] = { (uint16_t)trackId, 0, 0 };
-							sprintf(p, "track-list/%d/demux-w", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-								fl_value_set_string_take(info, "width", fl_value_new_int(size));
-								data[1] = (uint16_t)size;
-							}
-							sprintf(p, "track-list/%d/demux-h", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-								fl_value_set_string_take(info, "height", fl_value_new_int(size));
-								data[2] = (uint16_t)size;
-							}
-							g_array_append_val(self->videoTracks, data);
-							double fps;
-							sprintf(p, "track-list/%d/demux-fps", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_DOUBLE, &fps)) {
-								fl_value_set_string_take(info, "frameRate", fl_value_new_float(fps));
-							}
-						} else if (type == 1) {
-							sprintf(p, "track-list/%d/demux-channel-count", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-								fl_value_set_string_take(info, "channels", fl_value_new_int(size));
-							}
-							sprintf(p, "track-list/%d/demux-samplerate", i);
-							if (!mpv_get_property(self->mpv, p, MPV_FORMAT_INT64, &size)) {
-								fl_value_set_string_take(info, "sampleRate", fl_value_new_int(size));
-							}
-						}
-						sprintf(p, "%d.%ld", type, trackId);
-						fl_value_set_string_take(tracks, p, info);
-					}
+					FlValue* tracks = read_tracks(self->mpv, self->videoTracks);
 					mpv_get_property(self->mpv, "duration/full", MPV_FORMAT_DOUBLE, &duration);
 					mpv_get_property(self->mpv, "demuxer-via-network", MPV_FORMAT_FLAG, &networking);
 					mpv_set_property(self->mpv, "volume", MPV_FORMAT_DOUBLE, &self->volume);
 					self->streaming = duration == 0;
 					self->networking = networking == TRUE;
 					self->state = 2;
+					if (self->overrideVideo) {
+						av_media_player_overrideTrack(self, 0, self->overrideVideo, true);
+					}
+					if (self->overrideAudio) {
+						av_media_player_overrideTrack(self, 1, self->overrideAudio, true);
+					}
+					if (self->overrideSubtitle) {
+						av_media_player_overrideTrack(self, 2, self->overrideSubtitle, true);
+					}
 					av_media_player_set_max_resolution_real(self);
-					g_autoptr(FlValue) evt = fl_value_new_map();
-					fl_value_set_string_take(evt, "event", fl_value_new_string("mediaInfo"));
-					fl_value_set_string_take(evt, "source", fl_value_new_string(self->source));
-					fl_value_set_string_take(evt, "duration", fl_value_new_int((int64_t)(duration * 1000)));
-					fl_value_set_string_take(evt, "tracks", tracks);
-					fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+					av_media_player_apply_loop(self);
+					if (self->clipMaxDuration > 0 && !self->networking && duration > 0 && duration * 1000 <= self->clipMaxDuration) {
+						bool fits = self->videoTracks->len > 0;
+						for (uint i = 0; i < self->videoTracks->len; i++) {
+							AvMediaPlayerVideoTrack* track = &g_array_index(self->videoTracks, AvMediaPlayerVideoTrack, i);
+							if ((self->clipMaxWidth > 0 && track->width > self->clipMaxWidth) || (self->clipMaxHeight > 0 && track->height > self->clipMaxHeight)) {
+								fits = false;
+							}
+						}
+						if (fits) {
+							// clips are muted, and decoded until every frame has been captured
+							double fps = 0;
+							mpv_get_property(self->mpv, "container-fps", MPV_FORMAT_DOUBLE, &fps);
+							self->clipInterval = fps > 0 ? (int64_t)(1000 / fps) : 40;
+							self->clipDuration = (int64_t)(duration * 1000);
+							mpv_set_property_string(self->mpv, "aid", "no");
+							mpv_set_property_string(self->mpv, "framedrop", "no");
+							g_mutex_lock(&self->clipMutex);
+							self->clipState = 1;
+							g_mutex_unlock(&self->clipMutex);
+						}
+					}
+					g_autoptr(FlValue) info = fl_value_new_map();
+					fl_value_set_string_take(info, "duration", fl_value_new_int((int64_t)(duration * 1000)));
+					fl_value_set_string_take(info, "tracks", tracks);
+					int64_t probeTime = (g_get_monotonic_time() - self->openTime) / 1000;
+					if (self->reconnecting) {
+						// dart already knows the media
+						mpv_set_property_string(self->mpv, "start", "none");
+						self->reconnecting = false;
+						g_autoptr(FlValue) evt = fl_value_new_map();
+						fl_value_set_string_take(evt, "event", fl_value_new_string("recovered"));
+						fl_value_set_string_take(evt, "attempts", fl_value_new_int(self->reconnectAttempts));
+						fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+						self->reconnectAttempts = 0;
+					} else if (!self->cachedInfo || !fl_value_equal(self->cachedInfo, info)) {
+						g_autoptr(FlValue) evt = fl_value_new_map();
+						fl_value_set_string_take(evt, "event", fl_value_new_string("mediaInfo"));
+						fl_value_set_string_take(evt, "source", fl_value_new_string(self->source));
+						fl_value_set_string(evt, "duration", fl_value_lookup_string(info, "duration"));
+						fl_value_set_string(evt, "tracks", tracks);
+						fl_value_set_string_take(evt, "probeTime", fl_value_new_int(probeTime));
+						fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+						if (self->infoIdentity && !self->streaming) {
+							if (!plugin->infoPool) {
+								plugin->infoPool = g_thread_pool_new(media_info_write, NULL, 1, FALSE, NULL);
+							}
+							media_info_store(self->infoIdentity, info, plugin->infoPool);
+						}
+					} else {
+						// the cached info is still valid, only the time is new
+						g_autoptr(FlValue) evt = fl_value_new_map();
+						fl_value_set_string_take(evt, "event", fl_value_new_string("probeTime"));
+						fl_value_set_string_take(evt, "value", fl_value_new_int(probeTime));
+						fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+					}
+					if (self->pendingSeek >= 0) {
+						av_media_player_seek_to(self, self->pendingSeek);
+						self->pendingSeek = -1;
+					}
+					if (self->pendingPlay) {
+						self->pendingPlay = false;
+						av_media_player_play(self);
+					}
+					if (self->pendingStepCall) {
+						FlMethodCall* call = self->pendingStepCall;
+						self->pendingStepCall = NULL;
+						av_media_player_step_frame(self, self->pendingStep, call);
+						g_object_unref(call);
+					}
+					av_media_player_subtitle_file_flush(self, false);
 				}
 			} else if (event->event_id == MPV_EVENT_VIDEO_RECONFIG) {
-				if (self->state > 1) {
+				if (self->state > 1 && self->clipState < 2) {
+					if (self->clipState > 0) {
+						av_media_player_clip_release(self);
+					}
+					av_media_player_step_reset(self);
 					int64_t tmp;
 					mpv_get_property(self->mpv, "dwidth", MPV_FORMAT_INT64, &tmp);
 					self->width = (GLsizei)tmp;
 					mpv_get_property(self->mpv, "dheight", MPV_FORMAT_INT64, &tmp);
 					self->height = (GLsizei)tmp;
+					if (self->showSubtitle && self->subText) {
+						av_media_player_render_subtitle(self);
+					}
 					g_autoptr(FlValue) evt = fl_value_new_map();
 					fl_value_set_string_take(evt, "event", fl_value_new_string("videoSize"));
 					fl_value_set_string_take(evt, "width", fl_value_new_float(self->width));
 					fl_value_set_string_take(evt, "height", fl_value_new_float(self->height));
 					fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
 				}
+			} else if (event->event_id == MPV_EVENT_SEEK) {
+				if (self->state > 1 && !self->seeking) {
+					// a seek we didn't issue, either mpv wrapping around because of loop-file or ab-loop,
+					// or mpv seeking on its own after a track or variant switch. it's told apart once it lands
+					self->seeking = true;
+					self->wrapFrom = self->position;
+				}
 			} else if (event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
 				if (self->state > 1) {
-					g_autoptr(FlValue) evt = fl_value_new_map();
-					fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
-					fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+					self->seeking = false;
+					if (self->wrapFrom >= 0) {
+						av_media_player_check_wrap(self);
+					}
+					if (self->scrubbing || self->scrubPending || self->trickTimer) {
+						// report the frame that is actually displayed, it's usually a keyframe before the target
+						self->position = av_media_player_get_pos(self);
+						av_media_player_send_position(self);
+					}
+					if (self->scrubPending) {
+						self->scrubPending = false;
+						av_media_player_seek(self, self->scrubTarget, self->scrubbing ? "absolute+keyframes" : "absolute");
+						if (!self->scrubbing) {
+							self->scrubTarget = -1;
+						}
+					} else if (!self->trickTimer && self->stepState < 2) {
+						g_autoptr(FlValue) evt = fl_value_new_map();
+						fl_value_set_string_take(evt, "event", fl_value_new_string("seekEnd"));
+						fl_value_set_string_take(evt, "cached", fl_value_new_bool(self->seekCached || !self->networking));
+						fl_event_channel_send(self->eventChannel, evt, NULL, NULL);
+						self->seekCached = false;
+					}
 				}
 			}
 		}
 	}
-	return FALSE;
+	return FALSE;
+}
+
+static void wakeup_callback(void* id) {
+	// make sure event_callback is called in the main thread
+	g_idle_add(event_callback, id);
+}
+
+static void av_media_player_mark_mirrors(AvMediaPlayer* self) {
+	g_mutex_lock(&self->mirrorMutex);
+	for (uint i = 0; i < self->mirrors->len; i++) {
+		fl_texture_registrar_mark_texture_frame_available(self->textureRegistrar, FL_TEXTURE(g_ptr_array_index(self->mirrors, i)));
+	}
+	g_mutex_unlock(&self->mirrorMutex);
+}
+
+static void av_media_player_mirror_update(AvMediaPlayer* self, const GLuint texture, const GLsizei width, const GLsizei height) {
+	// called in the render thread with the frame that is shown
+	self->shownTexture = texture;
+	self->shownWidth = width;
+	self->shownHeight = height;
+	self->shownSerial++;
+	if (self->mirrors->len > 0) {
+		av_media_player_mark_mirrors(self);
+	}
+}
+
+static void texture_update_callback(void* id) {
+	// this function is not called in the main thread
+	g_mutex_lock(&plugin->mutex);
+	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
+	g_mutex_unlock(&plugin->mutex);
+	if (self) {
+		g_atomic_int_inc(&self->frameCount);
+		av_media_player_mark(self);
+		// mirrors render the frame themselves if the player is not shown
+		av_media_player_mark_mirrors(self);
+	}
+}
+
+static gboolean av_media_player_texture_render(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
+	AvMediaPlayer* self = AV_MEDIA_PLAYER(texture);
+	av_media_player_delete_stale(self);
+	g_mutex_lock(&self->clipMutex);
+	const uint8_t clipState = self->clipState;
+	g_mutex_unlock(&self->clipMutex);
+	if (clipState == 2) {
+		GLuint frame = av_media_player_clip_frame(self);
+		if (frame) {
+			av_media_player_snapshot_update(self, frame, self->clipWidth, self->clipHeight);
+			av_media_player_mirror_update(self, frame, self->clipWidth, self->clipHeight);
+			*target = GL_TEXTURE_2D;
+			*name = frame;
+			*width = self->clipWidth;
+			*height = self->clipHeight;
+			return TRUE;
+		}
+		return FALSE;
+	} else if (self->state > 0 && self->width > 0 && self->height > 0) {
+		if (self->stepIndex >= 0) {
+			// a cached frame is shown while stepping, mpv is paused elsewhere
+			GLuint frame = av_media_player_step_frame_texture(self);
+			if (frame) {
+				av_media_player_snapshot_update(self, frame, self->fbo.w, self->fbo.h);
+				av_media_player_mirror_update(self, frame, self->fbo.w, self->fbo.h);
+				*target = GL_TEXTURE_2D;
+				*name = frame;
+				*width = self->fbo.w;
+				*height = self->fbo.h;
+				return TRUE;
+			}
+		}
+		if (self->texture == 0 || self->width != self->fbo.w || self->height != self->fbo.h) {
+			if (self->texture) {
+				glDeleteTextures(1, &self->texture);
+			}
+			if (self->fbo.fbo) {
+				glDeleteFramebuffers(1, (GLuint*)&self->fbo.fbo);
+			}
+			glGenFramebuffers(1, (GLuint*)&self->fbo.fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, self->fbo.fbo);
+			glGenTextures(1, &self->texture);
+			glBindTexture(GL_TEXTURE_2D, self->texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, self->width, self->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 0, GL_TEXTURE_2D, self->texture, 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				return FALSE;
+			}
+			self->fbo.w = self->width;
+			self->fbo.h = self->height;
+		}
+		mpv_render_param params[] = {
+			{MPV_RENDER_PARAM_OPENGL_FBO, &self->fbo},
+			{MPV_RENDER_PARAM_INVALID, NULL},
+		};
+		const gint frameCount = g_atomic_int_get(&self->frameCount);
+		mpv_render_context_render(self->mpvRenderContext, params);
+		// client calls of mpv may deadlock in the render thread, so the pts comes from the time-pos observer
+		g_mutex_lock(&self->clipMutex);
+		const int64_t pts = self->framePts;
+		if (frameCount != self->renderedCount && pts == self->renderedPts && (clipState == 1 || self->stepState > 0 || self->tap)) {
+			// the observer has not seen this frame yet and marks the player again once it did
+			self->framePtsMissed = true;
+		}
+		g_mutex_unlock(&self->clipMutex);
+		self->renderedCount = frameCount;
+		self->renderedPts = pts;
+		if (clipState == 1) {
+			av_media_player_clip_capture(self, pts);
+		}
+		GLuint frame = 0;
+		if (self->stepState > 0) {
+			av_media_player_step_capture(self, pts);
+			frame = av_media_player_step_frame_texture(self);
+		}
+		if (self->tap) {
+			av_media_player_tap_render(self, self->texture, pts);
+		}
+		av_media_player_snapshot_update(self, frame ? frame : self->texture, self->width, self->height);
+		av_media_player_mirror_update(self, frame ? frame : self->texture, self->width, self->height);
+		*target = GL_TEXTURE_2D;
+		*name = frame ? frame : self->texture;
+		*width = self->width;
+		*height = self->height;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean av_media_player_texture_populate(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
+	AvMediaPlayer* self = AV_MEDIA_PLAYER(texture);
+	const guint serial = self->shownSerial;
+	if (av_media_player_texture_render(texture, target, name, width, height, error)) {
+		return TRUE;
+	}
+	if (self->shownTexture || self->shownSerial != serial) {
+		// no frame is shown, e.g. after close, and the previous one may be deleted already
+		av_media_player_mirror_update(self, 0, 0, 0);
+	}
+	return FALSE;
+}
+
+/* mirror class, an additional texture of a player at its own size, the shown frame is blitted into it so media is decoded once */
+#define AV_MEDIA_PLAYER_MIRROR(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), av_media_player_mirror_get_type(), AvMediaPlayerMirror))
+typedef struct {
+	FlTextureGL parent_instance;
+	GMutex mutex;          // guards player, which is cleared in the main thread
+	AvMediaPlayer* player; // NULL once the mirror is removed
+	uint16_t maxWidth;     // 0 for no limit
+	uint16_t maxHeight;
+	guint serial;          // shownSerial of the player when the frame was blitted
+	GLuint source;         // framebuffer to read the shown frame
+	GLuint texture;
+	GLuint fbo;
+	GLsizei width;
+	GLsizei height;
+} AvMediaPlayerMirror;
+typedef struct {
+	FlTextureGLClass parent_class;
+} AvMediaPlayerMirrorClass;
+G_DEFINE_TYPE(AvMediaPlayerMirror, av_media_player_mirror, fl_texture_gl_get_type())
+
+static void av_media_player_mirror_resize(AvMediaPlayerMirror* self, const GLsizei width, const GLsizei height, const void* pixels) {
+	if (self->texture) {
+		glDeleteTextures(1, &self->texture);
+		glDeleteFramebuffers(1, &self->fbo);
+	}
+	glGenTextures(1, &self->texture);
+	glBindTexture(GL_TEXTURE_2D, self->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glGenFramebuffers(1, &self->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, self->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	self->width = width;
+	self->height = height;
+}
+
+static gboolean av_media_player_mirror_populate(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
+	AvMediaPlayerMirror* self = AV_MEDIA_PLAYER_MIRROR(texture);
+	g_mutex_lock(&self->mutex);
+	AvMediaPlayer* player = self->player;
+	if (player && g_atomic_int_get(&player->frameCount) != player->renderedCount) {
+		// the player itself has not been populated since mpv made a new frame, e.g. it's not on screen
+		uint32_t t, n, w, h;
+		av_media_player_texture_populate(FL_TEXTURE_GL(player), &t, &n, &w, &h, NULL);
+	}
+	if (player && player->shownTexture && self->serial != player->shownSerial) {
+		double scale = 1.0;
+		if (self->maxWidth > 0) {
+			scale = MIN(scale, (double)self->maxWidth / player->shownWidth);
+		}
+		if (self->maxHeight > 0) {
+			scale = MIN(scale, (double)self->maxHeight / player->shownHeight);
+		}
+		const GLsizei w = MAX((GLsizei)(player->shownWidth * scale), 1);
+		const GLsizei h = MAX((GLsizei)(player->shownHeight * scale), 1);
+		if (self->width != w || self->height != h) {
+			av_media_player_mirror_resize(self, w, h, NULL);
+		}
+		if (!self->source) {
+			glGenFramebuffers(1, &self->source);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, self->source);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, player->shownTexture, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, self->fbo);
+		glBlitFramebuffer(0, 0, player->shownWidth, player->shownHeight, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		self->serial = player->shownSerial;
+	} else if (!self->texture || (player && self->serial != player->shownSerial)) {
+		// nothing is shown, so the mirror is cleared instead of keeping the last frame
+		static const guint8 transparent[4] = {0, 0, 0, 0};
+		av_media_player_mirror_resize(self, 1, 1, transparent);
+		self->serial = player ? player->shownSerial : 0;
+	}
+	*target = GL_TEXTURE_2D;
+	*name = self->texture;
+	*width = self->width;
+	*height = self->height;
+	g_mutex_unlock(&self->mutex);
+	return TRUE;
+}
+
+static void av_media_player_mirror_dispose(GObject* obj) {
+	AvMediaPlayerMirror* self = AV_MEDIA_PLAYER_MIRROR(obj);
+	if (self->texture) {
+		glDeleteTextures(1, &self->texture);
+		glDeleteFramebuffers(1, &self->fbo);
+		self->texture = 0;
+	}
+	if (self->source) {
+		glDeleteFramebuffers(1, &self->source);
+		self->source = 0;
+	}
+	G_OBJECT_CLASS(av_media_player_mirror_parent_class)->dispose(obj);
+}
+
+static void av_media_player_mirror_finalize(GObject* obj) {
+	g_mutex_clear(&AV_MEDIA_PLAYER_MIRROR(obj)->mutex);
+	G_OBJECT_CLASS(av_media_player_mirror_parent_class)->finalize(obj);
+}
+
+static void av_media_player_mirror_class_init(AvMediaPlayerMirrorClass* klass) {
+	FL_TEXTURE_GL_CLASS(klass)->populate = av_media_player_mirror_populate;
+	G_OBJECT_CLASS(klass)->dispose = av_media_player_mirror_dispose;
+	G_OBJECT_CLASS(klass)->finalize = av_media_player_mirror_finalize;
+}
+
+static void av_media_player_mirror_init(AvMediaPlayerMirror* self) {
+	g_mutex_init(&self->mutex);
+	self->player = NULL;
+	self->serial = 0;
+	self->source = 0;
+	self->texture = 0;
+	self->fbo = 0;
+	self->width = 0;
+	self->height = 0;
+}
+
+static int64_t av_media_player_add_mirror(AvMediaPlayer* self, const uint16_t maxWidth, const uint16_t maxHeight) {
+	AvMediaPlayerMirror* mirror = AV_MEDIA_PLAYER_MIRROR(g_object_new(av_media_player_mirror_get_type(), NULL));
+	mirror->player = self;
+	mirror->maxWidth = maxWidth;
+	mirror->maxHeight = maxHeight;
+	fl_texture_registrar_register_texture(self->textureRegistrar, FL_TEXTURE(mirror));
+	g_mutex_lock(&self->mirrorMutex);
+	g_ptr_array_add(self->mirrors, mirror);
+	g_mutex_unlock(&self->mirrorMutex);
+	av_media_player_mark(self);
+	fl_texture_registrar_mark_texture_frame_available(self->textureRegistrar, FL_TEXTURE(mirror));
+	return fl_texture_get_id(FL_TEXTURE(mirror));
+}
+
+static void av_media_player_mirror_release(AvMediaPlayer* self, AvMediaPlayerMirror* mirror) {
+	g_mutex_lock(&mirror->mutex);
+	mirror->player = NULL;
+	g_mutex_unlock(&mirror->mutex);
+	fl_texture_registrar_unregister_texture(self->textureRegistrar, FL_TEXTURE(mirror));
+	g_object_unref(mirror);
+}
+
+static void av_media_player_remove_mirror(AvMediaPlayer* self, const int64_t textureId) {
+	AvMediaPlayerMirror* mirror = NULL;
+	g_mutex_lock(&self->mirrorMutex);
+	for (uint i = 0; i < self->mirrors->len; i++) {
+		if (fl_texture_get_id(FL_TEXTURE(g_ptr_array_index(self->mirrors, i))) == textureId) {
+			mirror = g_ptr_array_remove_index(self->mirrors, i);
+			break;
+		}
+	}
+	g_mutex_unlock(&self->mirrorMutex);
+	if (mirror) {
+		av_media_player_mirror_release(self, mirror);
+	}
 }
 
-static void wakeup_callback(void* id) {
-	// make sure event_callback is called in the main thread
-	g_idle_add(event_callback, id);
+/* video wall, players on a wall mark the wall instead of their own textures, and the wall draws the frames of all marked players
+   into their tiles once per vsync, so flutter composites one texture no matter how many tiles there are */
+
+static gboolean av_media_player_wall_populate(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
+	AvMediaPlayerWall* self = AV_MEDIA_PLAYER_WALL(texture);
+	const GLsizei w = self->columns * self->tileWidth;
+	const GLsizei h = self->rows * self->tileHeight;
+	// players marked from now on are drawn in the next vsync
+	g_atomic_int_set(&self->pending, 0);
+	g_mutex_lock(&self->mutex);
+	if (!self->texture) {
+		glGenTextures(1, &self->texture);
+		glBindTexture(GL_TEXTURE_2D, self->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glGenFramebuffers(1, &self->fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, self->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->texture, 0);
+		glGenFramebuffers(1, &self->source);
+		self->clear = true;
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, self->fbo);
+	glClearColor(0, 0, 0, 0);
+	if (self->clear) {
+		self->clear = false;
+		glClear(GL_COLOR_BUFFER_BIT);
+		memset(self->serials, 0, sizeof(guint) * self->columns * self->rows);
+	}
+	for (int i = 0; i < self->columns * self->rows; i++) {
+		AvMediaPlayer* player = self->tiles[i];
+		if (!player) {
+			continue;
+		}
+		if (g_atomic_int_compare_and_exchange(&player->wallDirty, 1, 0)) {
+			// renders the new frame of mpv, or picks the frame shown from memory
+			uint32_t t, n, pw, ph;
+			av_media_player_texture_populate(FL_TEXTURE_GL(player), &t, &n, &pw, &ph, NULL);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, self->fbo);
+		}
+		if (self->serials[i] == player->shownSerial) {
+			continue;
+		}
+		self->serials[i] = player->shownSerial;
+		const GLint x = (i % self->columns) * self->tileWidth;
+		const GLint y = (i / self->columns) * self->tileHeight;
+		if (!player->shownTexture) {
+			// nothing is shown, e.g. the player was closed, and the frame drawn before may be deleted already
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(x, y, self->tileWidth, self->tileHeight);
+			glClear(GL_COLOR_BUFFER_BIT);
+			glDisable(GL_SCISSOR_TEST);
+			continue;
+		}
+		// fit the frame into the tile, the rows of the atlas start at the top like the frames of mpv
+		const double scale = MIN((double)self->tileWidth / player->shownWidth, (double)self->tileHeight / player->shownHeight);
+		const GLsizei fw = MAX((GLsizei)(player->shownWidth * scale), 1);
+		const GLsizei fh = MAX((GLsizei)(player->shownHeight * scale), 1);
+		const GLint fx = x + (self->tileWidth - fw) / 2;
+		const GLint fy = y + (self->tileHeight - fh) / 2;
+		if (fw < self->tileWidth || fh < self->tileHeight) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(x, y, self->tileWidth, self->tileHeight);
+			glClear(GL_COLOR_BUFFER_BIT);
+			glDisable(GL_SCISSOR_TEST);
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, self->source);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, player->shownTexture, 0);
+		glBlitFramebuffer(0, 0, player->shownWidth, player->shownHeight, fx, fy, fx + fw, fy + fh, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	g_mutex_unlock(&self->mutex);
+	*target = GL_TEXTURE_2D;
+	*name = self->texture;
+	*width = w;
+	*height = h;
+	return TRUE;
 }
 
-static void texture_update_callback(void* id) {
-	// this function is not called in the main thread
-	g_mutex_lock(&plugin->mutex);
-	AvMediaPlayer* self = g_tree_lookup(plugin->players, id);
-	g_mutex_unlock(&plugin->mutex);
-	if (self) {
+static void av_media_player_wall_mark(AvMediaPlayerWall* self) {
+	if (g_atomic_int_compare_and_exchange(&self->pending, 0, 1)) {
 		fl_texture_registrar_mark_texture_frame_available(self->textureRegistrar, FL_TEXTURE(self));
 	}
 }
 
-static gboolean av_media_player_texture_populate(FlTextureGL* texture, uint32_t* target, uint32_t* name, uint32_t* width, uint32_t* height, GError** error) {
-	AvMediaPlayer* self = AV_MEDIA_PLAYER(texture);
-	if (self->state > 0 && self->width > 0 && self->height > 0) {
-		if (self->texture == 0 || self->width != self->fbo.w || self->height != self->fbo.h) {
-			if (self->texture) {
-				glDeleteTextures(1, &self->texture);
-			}
-			if (self->fbo.fbo) {
-				glDeleteFramebuffers(1, (GLuint*)&self->fbo.fbo);
+static void av_media_player_wall_leave(AvMediaPlayer* player) {
+	g_mutex_lock(&player->mirrorMutex);
+	AvMediaPlayerWall* wall = player->wall;
+	player->wall = NULL;
+	g_mutex_unlock(&player->mirrorMutex);
+	if (wall) {
+		g_mutex_lock(&wall->mutex);
+		for (int i = 0; i < wall->columns * wall->rows; i++) {
+			if (wall->tiles[i] == player) {
+				wall->tiles[i] = NULL;
+				wall->clear = true;
 			}
-			glGenFramebuffers(1, (GLuint*)&self->fbo.fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, self->fbo.fbo);
-			glGenTextures(1, &self->texture);
-			glBindTexture(GL_TEXTURE_2D, self->texture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, self->width, self->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + 0, GL_TEXTURE_2D, self->texture, 0);
-			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-				return FALSE;
+		}
+		g_mutex_unlock(&wall->mutex);
+		av_media_player_wall_mark(wall);
+	}
+}
+
+static void av_media_player_wall_set_tile(AvMediaPlayerWall* self, const int index, AvMediaPlayer* player) {
+	if (index < 0 || index >= self->columns * self->rows) {
+		return;
+	}
+	if (player) {
+		av_media_player_wall_leave(player);
+	}
+	g_mutex_lock(&self->mutex);
+	AvMediaPlayer* previous = self->tiles[index];
+	self->tiles[index] = player;
+	self->serials[index] = 0;
+	if (!player) {
+		self->clear = true;
+	}
+	g_mutex_unlock(&self->mutex);
+	if (previous && previous != player) {
+		g_mutex_lock(&previous->mirrorMutex);
+		previous->wall = NULL;
+		g_mutex_unlock(&previous->mirrorMutex);
+		av_media_player_mark(previous);
+	}
+	if (player) {
+		g_mutex_lock(&player->mirrorMutex);
+		player->wall = self;
+		g_mutex_unlock(&player->mirrorMutex);
+		av_media_player_mark(player);
+	}
+	av_media_player_wall_mark(self);
+}
+
+static void av_media_player_wall_dispose(GObject* obj) {
+	AvMediaPlayerWall* self = AV_MEDIA_PLAYER_WALL(obj);
+	if (self->tiles) {
+		for (int i = 0; i < self->columns * self->rows; i++) {
+			AvMediaPlayer* player = self->tiles[i];
+			if (player) {
+				g_mutex_lock(&player->mirrorMutex);
+				player->wall = NULL;
+				g_mutex_unlock(&player->mirrorMutex);
+				av_media_player_mark(player);
 			}
-			self->fbo.w = self->width;
-			self->fbo.h = self->height;
 		}
-		mpv_render_param params[] = {
-			{MPV_RENDER_PARAM_OPENGL_FBO, &self->fbo},
-			{MPV_RENDER_PARAM_INVALID, NULL},
-		};
-		mpv_render_context_render(self->mpvRenderContext, params);
-		*target = GL_TEXTURE_2D;
-		*name = self->texture;
-		*width = self->width;
-		*height = self->height;
-		return TRUE;
+		g_mutex_lock(&self->mutex);
+		g_free(self->tiles);
+		g_free(self->serials);
+		self->tiles = NULL;
+		self->serials = NULL;
+		g_mutex_unlock(&self->mutex);
 	}
-	return FALSE;
+	if (self->texture) {
+		glDeleteTextures(1, &self->texture);
+		glDeleteFramebuffers(1, &self->fbo);
+		glDeleteFramebuffers(1, &self->source);
+		self->texture = 0;
+	}
+	G_OBJECT_CLASS(av_media_player_wall_parent_class)->dispose(obj);
+}
+
+static void av_media_player_wall_finalize(GObject* obj) {
+	g_mutex_clear(&AV_MEDIA_PLAYER_WALL(obj)->mutex);
+	G_OBJECT_CLASS(av_media_player_wall_parent_class)->finalize(obj);
+}
+
+static void av_media_player_wall_class_init(AvMediaPlayerWallClass* klass) {
+	FL_TEXTURE_GL_CLASS(klass)->populate = av_media_player_wall_populate;
+	G_OBJECT_CLASS(klass)->dispose = av_media_player_wall_dispose;
+	G_OBJECT_CLASS(klass)->finalize = av_media_player_wall_finalize;
+}
+
+static void av_media_player_wall_init(AvMediaPlayerWall* self) {
+	g_mutex_init(&self->mutex);
+	self->textureRegistrar = NULL;
+	self->tiles = NULL;
+	self->serials = NULL;
+	self->columns = 0;
+	self->rows = 0;
+	self->tileWidth = 0;
+	self->tileHeight = 0;
+	self->pending = 0;
+	self->clear = true;
+	self->source = 0;
+	self->texture = 0;
+	self->fbo = 0;
+}
+
+static AvMediaPlayerWall* av_media_player_wall_new(FlTextureRegistrar* textureRegistrar, const uint16_t columns, const uint16_t rows, const uint16_t tileWidth, const uint16_t tileHeight) {
+	AvMediaPlayerWall* self = AV_MEDIA_PLAYER_WALL(g_object_new(av_media_player_wall_get_type(), NULL));
+	self->textureRegistrar = textureRegistrar;
+	self->columns = MAX(columns, 1);
+	self->rows = MAX(rows, 1);
+	self->tileWidth = MAX(tileWidth, 1);
+	self->tileHeight = MAX(tileHeight, 1);
+	self->tiles = g_new0(gpointer, self->columns * self->rows);
+	self->serials = g_new0(guint, self->columns * self->rows);
+	fl_texture_registrar_register_texture(textureRegistrar, FL_TEXTURE(self));
+	av_media_player_wall_mark(self);
+	return self;
+}
+
+static void av_media_player_wall_release(gpointer data) {
+	AvMediaPlayerWall* self = data;
+	fl_texture_registrar_unregister_texture(self->textureRegistrar, FL_TEXTURE(self));
+	g_object_unref(self);
 }
 
 static void av_media_player_dispose(GObject* obj) {
 	AvMediaPlayer* self = AV_MEDIA_PLAYER(obj);
 	g_idle_remove_by_data(self);
 	fl_event_channel_send_end_of_stream(self->eventChannel, NULL, NULL);
+	// walls and mirrors may render the player until they let it go
+	av_media_player_wall_leave(self);
+	for (uint i = 0; i < self->mirrors->len; i++) {
+		av_media_player_mirror_release(self, g_ptr_array_index(self->mirrors, i));
+	}
+	g_ptr_array_set_size(self->mirrors, 0);
 	mpv_render_context_free(self->mpvRenderContext);
 	mpv_destroy(self->mpv);
 	g_free(self->source);
+	g_free(self->infoIdentity);
+	if (self->cachedInfo) {
+		fl_value_unref(self->cachedInfo);
+	}
 	g_array_free(self->videoTracks, TRUE);
+	g_array_free(self->cacheRanges, TRUE);
+	av_media_player_abr_stop(self);
+	if (self->liveTimer) {
+		g_source_remove(self->liveTimer);
+	}
+	if (self->trickTimer) {
+		g_source_remove(self->trickTimer);
+	}
+	if (self->reconnectTimer) {
+		g_source_remove(self->reconnectTimer);
+	}
+	av_media_player_clip_release(self);
+	av_media_player_step_reset(self);
+	av_media_player_drop_pending_step(self);
+	g_array_free(self->stepFrames, TRUE);
+	if (self->staleTextures->len > 0) {
+		glDeleteTextures((GLsizei)self->staleTextures->len, (GLuint*)self->staleTextures->data);
+	}
+	g_array_free(self->staleTextures, TRUE);
+	if (self->clipFbo) {
+		glDeleteFramebuffers(1, &self->clipFbo);
+	}
+	if (self->snapshotTimer) {
+		g_source_remove(self->snapshotTimer);
+	}
+	for (uint i = 0; i < self->snapshots->len; i++) {
+		// the frame will never be read back
+		AvMediaPlayerSnapshotJob* job = g_ptr_array_index(self->snapshots, i);
+		if (job->fence) {
+			glDeleteSync(job->fence);
+			glDeleteBuffers(1, &job->pbo);
+			glDeleteFramebuffers(1, &job->fbo);
+			glDeleteTextures(1, &job->texture);
+		}
+		job->error = g_strdup("player disposed");
+		av_media_player_snapshot_respond(job);
+	}
+	g_ptr_array_free(self->snapshots, TRUE);
+	if (self->tap) {
+		av_media_player_tap_free(self->tap);
+	}
+	for (uint i = 0; i < self->staleTaps->len; i++) {
+		av_media_player_tap_free(g_ptr_array_index(self->staleTaps, i));
+	}
+	g_ptr_array_free(self->staleTaps, TRUE);
+	g_array_free(self->clipFrames, TRUE);
+	g_mutex_clear(&self->clipMutex);
+	g_ptr_array_free(self->mirrors, TRUE);
+	g_mutex_clear(&self->mirrorMutex);
+	fl_texture_registrar_unregister_texture(self->textureRegistrar, FL_TEXTURE(self->subtitle));
+	g_object_unref(self->subtitle);
+	g_free(self->subText);
+	g_ptr_array_free(self->subtitleFiles, TRUE);
+	av_media_player_subtitle_file_flush(self, true);
+	g_ptr_array_free(self->subtitleJobs, TRUE);
 	fl_texture_registrar_unregister_texture(self->textureRegistrar, FL_TEXTURE(self));
 	if (self->texture) {
 		glDeleteTextures(1, &self->texture);
@@ -548,8 +3411,36 @@ static void av_media_player_init(AvMediaPlayer* self) {
 	self->fbo.w = 0;
 	self->fbo.h = 0;
 	self->fbo.internal_format = GL_RGBA8;
+	self->subtitle = AV_MEDIA_PLAYER_SUBTITLE(g_object_new(av_media_player_subtitle_get_type(), NULL));
+	self->subText = NULL;
+	self->showSubtitle = false;
+	self->subOverlay = true;
+	self->subtitleFiles = g_ptr_array_new_with_free_func(av_media_player_subtitle_file_free);
+	self->subtitleJobs = g_ptr_array_new();
+	self->subtitleFile = NULL;
+	self->cueFrom = 0;
+	self->cueUntil = 0;
 	self->speed = 1;
 	self->looping = false;
+	self->loopBegin = 0;
+	self->loopEnd = 0;
+	self->seeking = false;
+	self->wrapFrom = -1;
+	self->scrubbing = false;
+	self->scrubPending = false;
+	self->scrubTarget = -1;
+	self->pendingSeek = -1;
+	self->liveRate = 1;
+	self->trickRate = 0;
+	self->trickTimer = 0;
+	self->abrSafety = 0.8;
+	self->abrUpBuffer = 10000;
+	self->abrInterval = 10000;
+	self->pendingPlay = false;
+	self->pendingStepCall = NULL;
+	self->pendingStep = 0;
+	self->infoIdentity = NULL;
+	self->cachedInfo = NULL;
 	self->state = 0;
 	self->position = 0;
 	self->bufferPosition = 0;
@@ -557,7 +3448,53 @@ static void av_media_player_init(AvMediaPlayer* self) {
 	self->streaming = false;
 	self->networking = false;
 	self->mpv = mpv_create();
-	self->videoTracks = g_array_new(FALSE, FALSE, sizeof(uint16_t) * 3);
+	self->videoTracks = g_array_new(FALSE, FALSE, sizeof(AvMediaPlayerVideoTrack));
+	self->cacheRanges = g_array_new(FALSE, FALSE, sizeof(int64_t));
+	self->clipFrames = g_array_new(FALSE, FALSE, sizeof(AvMediaPlayerClipFrame));
+	self->staleTextures = g_array_new(FALSE, FALSE, sizeof(GLuint));
+	self->stepFrames = g_array_new(FALSE, FALSE, sizeof(AvMediaPlayerClipFrame));
+	self->stepMemory = 0;
+	self->stepLast = -1;
+	self->stepTarget = -1;
+	self->stepIndex = -1;
+	self->stepState = 0;
+	self->stepCall = NULL;
+	self->snapshots = g_ptr_array_new();
+	self->snapshotTimer = 0;
+	self->tap = NULL;
+	self->staleTaps = g_ptr_array_new();
+	self->tapPending = false;
+	self->mirrors = g_ptr_array_new();
+	g_mutex_init(&self->mirrorMutex);
+	self->wall = NULL;
+	self->wallDirty = 0;
+	self->frameCount = 0;
+	self->renderedCount = 0;
+	self->shownTexture = 0;
+	self->shownWidth = 0;
+	self->shownHeight = 0;
+	self->shownSerial = 0;
+	g_mutex_init(&self->clipMutex);
+	self->clipState = 0;
+	self->clipDuration = 0;
+	self->clipClock = 0;
+	self->clipClockTime = 0;
+	self->clipMemory = 0;
+	self->clipMaxDuration = 0;
+	self->clipMaxWidth = 0;
+	self->clipMaxHeight = 0;
+	self->clipFrameWidth = 0;
+	self->clipFrameHeight = 0;
+	self->clipWidth = 0;
+	self->clipHeight = 0;
+	self->clipInterval = 0;
+	self->clipLast = -1;
+	self->clipPasses = 0;
+	self->framePts = -1;
+	self->framePtsMissed = false;
+	self->renderedPts = -1;
+	self->clipTimer = 0;
+	self->clipFbo = 0;
 	av_media_player_set_volume(self, 1);
 	//mpv_set_option_string(self->mpv, "terminal", "yes");
 	//mpv_set_option_string(self->mpv, "msg-level", "all=v");
@@ -565,14 +3502,18 @@ static void av_media_player_init(AvMediaPlayer* self) {
 	mpv_set_property_string(self->mpv, "hwdec", "auto-safe");
 	mpv_set_property_string(self->mpv, "keep-open", "yes");
 	mpv_set_property_string(self->mpv, "idle", "yes");
+	mpv_set_property_string(self->mpv, "demuxer-seekable-cache", "yes"); // serve loop and backward seeks from the demuxer cache
 	//mpv_set_property_string(self->mpv, "sub-create-cc-track", "yes");
 	//mpv_set_property_string(self->mpv, "cache", "no");
-	av_media_player_set_show_subtitle(self, false);
+	mpv_set_property_string(self->mpv, "sub-visibility", "no"); // text subtitles are drawn into the overlay texture, see av_media_player_set_sub_codec
 	mpv_initialize(self->mpv);
+	av_media_player_stream_attach(self->mpv);
 	mpv_observe_property(self->mpv, 0, "time-pos/full", MPV_FORMAT_DOUBLE);
-	mpv_observe_property(self->mpv, 0, "demuxer-cache-time", MPV_FORMAT_DOUBLE);
+	mpv_observe_property(self->mpv, 0, "demuxer-cache-state", MPV_FORMAT_NODE);
 	mpv_observe_property(self->mpv, 0, "paused-for-cache", MPV_FORMAT_FLAG);
 	mpv_observe_property(self->mpv, 0, "pause", MPV_FORMAT_FLAG);
+	mpv_observe_property(self->mpv, 0, "sub-text", MPV_FORMAT_STRING);
+	mpv_observe_property(self->mpv, 0, "current-tracks/sub/codec", MPV_FORMAT_STRING);
 	mpv_opengl_init_params gl_init_params = { gl_init, NULL };
 	GdkDisplay* display = gdk_display_get_default();
 	if (GDK_IS_WAYLAND_DISPLAY(display)) {
@@ -593,6 +3534,7 @@ static AvMediaPlayer* av_media_player_new(FlMethodCodec* codec, FlBinaryMessenge
 	FlTexture* texture = FL_TEXTURE(self);
 	self->textureRegistrar = textureRegistrar;
 	fl_texture_registrar_register_texture(self->textureRegistrar, texture);
+	fl_texture_registrar_register_texture(self->textureRegistrar, FL_TEXTURE(self->subtitle));
 	self->id = fl_texture_get_id(texture);
 	gchar* name = g_strdup_printf("av_media_player/%ld", self->id);
 	self->eventChannel = fl_event_channel_new(messenger, name, codec);
@@ -602,12 +3544,488 @@ static AvMediaPlayer* av_media_player_new(FlMethodCodec* codec, FlBinaryMessenge
 	return self;
 }
 
+/* thumbnail generation, runs in worker threads with its own mpv instances */
+#define AV_MEDIA_PLAYER_THUMBNAIL_MAX_SIZE 1024   // largest cell size
+#define AV_MEDIA_PLAYER_THUMBNAIL_MAX_SHEET 8192  // largest sheet size, longer media get fewer cells
+
+typedef struct {
+	FlMethodCall* call;
+	gchar* source;
+	gchar* path;
+	int64_t interval; // in milliseconds
+	uint16_t width;
+	uint16_t height;
+	FlValue* result;
+	gchar* error;
+} AvMediaPlayerThumbnailJob;
+
+static mpv_event_id av_media_player_wait_event(mpv_handle* mpv, const mpv_event_id id, const double timeout) {
+	// returns id on success, MPV_EVENT_END_FILE on failure or MPV_EVENT_NONE on timeout
+	int64_t deadline = g_get_monotonic_time() + (int64_t)(timeout * G_USEC_PER_SEC);
+	while (g_get_monotonic_time() < deadline) {
+		mpv_event* event = mpv_wait_event(mpv, (double)(deadline - g_get_monotonic_time()) / G_USEC_PER_SEC);
+		if (event->event_id == id) {
+			return id;
+		} else if (event->event_id == MPV_EVENT_END_FILE || event->event_id == MPV_EVENT_SHUTDOWN) {
+			return MPV_EVENT_END_FILE;
+		}
+	}
+	return MPV_EVENT_NONE;
+}
+
+static gchar* av_media_player_thumbnail_key(AvMediaPlayerThumbnailJob* job) {
+	GStatBuf st;
+	gchar* identity;
+	if (g_stat(job->path, &st) == 0) {
+		// local files are also identified by their modification time and size
+		identity = g_strdup_printf("%s|%ld|%ld|%ld|%dx%d", job->path, (long)st.st_mtime, (long)st.st_size, (long)job->interval, job->width, job->height);
+	} else {
+		identity = g_strdup_printf("%s|%ld|%dx%d", job->source, (long)job->interval, job->width, job->height);
+	}
+	gchar* key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, identity, -1);
+	g_free(identity);
+	return key;
+}
+
+static FlValue* av_media_player_thumbnail_result(const gchar* path, const int64_t columns, const int64_t rows, const int64_t width, const int64_t height, GArray* timestamps) {
+	FlValue* result = fl_value_new_map();
+	fl_value_set_string_take(result, "path", fl_value_new_string(path));
+	fl_value_set_string_take(result, "columns", fl_value_new_int(columns));
+	fl_value_set_string_take(result, "rows", fl_value_new_int(rows));
+	fl_value_set_string_take(result, "width", fl_value_new_int(width));
+	fl_value_set_string_take(result, "height", fl_value_new_int(height));
+	fl_value_set_string_take(result, "timestamps", fl_value_new_int64_list((int64_t*)timestamps->data, timestamps->len));
+	return result;
+}
+
+static void av_media_player_thumbnail_load(AvMediaPlayerThumbnailJob* job, const gchar* image, const gchar* index) {
+	// the index file holds "columns rows width height" followed by one timestamp per cell
+	gchar* contents;
+	if (g_file_test(image, G_FILE_TEST_IS_REGULAR) && g_file_get_contents(index, &contents, NULL, NULL)) {
+		gchar** lines = g_strsplit(contents, "\n", -1);
+		int64_t columns, rows, width, height;
+		if (lines[0] && sscanf(lines[0], "%ld %ld %ld %ld", &columns, &rows, &width, &height) == 4) {
+			GArray* timestamps = g_array_new(FALSE, FALSE, sizeof(int64_t));
+			for (uint i = 1; lines[i] && lines[i][0]; i++) {
+				int64_t pts = g_ascii_strtoll(lines[i], NULL, 10);
+				g_array_append_val(timestamps, pts);
+			}
+			job->result = av_media_player_thumbnail_result(image, columns, rows, width, height, timestamps);
+			g_array_free(timestamps, TRUE);
+		}
+		g_strfreev(lines);
+		g_free(contents);
+	}
+}
+
+static void av_media_player_thumbnail_generate(AvMediaPlayerThumbnailJob* job, const gchar* image, const gchar* index) {
+	mpv_handle* mpv = mpv_create();
+	mpv_set_property_string(mpv, "vo", "libmpv");
+	mpv_set_property_string(mpv, "ao", "null");
+	mpv_set_property_string(mpv, "aid", "no");
+	mpv_set_property_string(mpv, "sid", "no");
+	mpv_set_property_string(mpv, "hwdec", "no");
+	mpv_set_property_string(mpv, "hr-seek", "no");
+	mpv_set_property_string(mpv, "pause", "yes");
+	mpv_set_property_string(mpv, "keep-open", "yes");
+	mpv_set_property_string(mpv, "idle", "yes");
+	mpv_set_property_string(mpv, "demuxer-readahead-secs", "0");
+	mpv_initialize(mpv);
+	av_media_player_stream_attach(mpv);
+	mpv_render_context* renderContext = NULL;
+	mpv_render_param params[] = {
+		{MPV_RENDER_PARAM_API_TYPE, MPV_RENDER_API_TYPE_SW},
+		{MPV_RENDER_PARAM_INVALID, NULL}
+	};
+	const gchar* load[] = { "loadfile", job->path, NULL };
+	if (mpv_render_context_create(&renderContext, mpv, params) < 0) {
+		job->error = g_strdup("software renderer is not available");
+	} else if (mpv_command(mpv, load) < 0 || av_media_player_wait_event(mpv, MPV_EVENT_FILE_LOADED, 30) != MPV_EVENT_FILE_LOADED) {
+		job->error = g_strdup("failed to load media");
+	} else if (av_media_player_wait_event(mpv, MPV_EVENT_VIDEO_RECONFIG, 10) != MPV_EVENT_VIDEO_RECONFIG) {
+		job->error = g_strdup("media has no video");
+	} else {
+		double duration = 0;
+		int64_t dw = 0, dh = 0;
+		mpv_get_property(mpv, "duration/full", MPV_FORMAT_DOUBLE, &duration);
+		mpv_get_property(mpv, "dwidth", MPV_FORMAT_INT64, &dw);
+		mpv_get_property(mpv, "dheight", MPV_FORMAT_INT64, &dh);
+		if (duration <= 0 || dw <= 0 || dh <= 0) {
+			job->error = g_strdup("media is not seekable");
+		} else {
+			// fit the video into the requested cell size
+			int w = job->width;
+			int h = (int)(dh * job->width / dw);
+			if (h > job->height) {
+				h = job->height;
+				w = (int)(dw * job->height / dh);
+			}
+			w = MAX(w, 2) & ~1;
+			h = MAX(h, 2) & ~1;
+			int size[] = { w, h };
+			size_t stride = ((size_t)w * 4 + 63) & ~(size_t)63;
+			// keyframe index: only keyframes are decoded, and each distinct keyframe becomes one cell
+			GArray* timestamps = g_array_new(FALSE, FALSE, sizeof(int64_t));
+			GByteArray* cells = g_byte_array_new();
+			// the square sheet must not exceed AV_MEDIA_PLAYER_THUMBNAIL_MAX_SHEET, so long media are sampled sparser
+			const int64_t side = MIN(AV_MEDIA_PLAYER_THUMBNAIL_MAX_SHEET / w, AV_MEDIA_PLAYER_THUMBNAIL_MAX_SHEET / h);
+			const int64_t interval = MAX(job->interval, (int64_t)(duration * 1000) / (side * side) + 1);
+			int64_t count = MIN((int64_t)(duration * 1000) / interval + 1, side * side);
+			for (int64_t i = 0; i < count; i++) {
+				if (g_atomic_int_get(&plugin->thumbnailCancelled)) {
+					job->error = g_strdup("plugin disposed");
+					break;
+				}
+				gchar* t = g_strdup_printf("%lf", (double)(i * interval) / 1000);
+				const gchar* seek[] = { "seek", t, "absolute+keyframes", NULL };
+				int result = mpv_command(mpv, seek);
+				g_free(t);
+				if (result < 0 || av_media_player_wait_event(mpv, MPV_EVENT_PLAYBACK_RESTART, 10) != MPV_EVENT_PLAYBACK_RESTART) {
+					break;
+				}
+				double pos;
+				if (mpv_get_property(mpv, "time-pos/full", MPV_FORMAT_DOUBLE, &pos) == 0) {
+					int64_t pts = (int64_t)(pos * 1000);
+					if (timestamps->len == 0 || pts > g_array_index(timestamps, int64_t, timestamps->len - 1)) {
+						// mpv renders straight into the cell buffer, rows are repacked when the sheet is built
+						const guint offset = cells->len;
+						g_byte_array_set_size(cells, offset + (guint)(stride * h));
+						mpv_render_param render[] = {
+							{MPV_RENDER_PARAM_SW_SIZE, size},
+							{MPV_RENDER_PARAM_SW_FORMAT, "rgb0"},
+							{MPV_RENDER_PARAM_SW_STRIDE, &stride},
+							{MPV_RENDER_PARAM_SW_POINTER, &cells->data[offset]},
+							{MPV_RENDER_PARAM_INVALID, NULL}
+						};
+						mpv_render_context_update(renderContext);
+						if (mpv_render_context_render(renderContext, render) < 0) {
+							g_byte_array_set_size(cells, offset);
+							break;
+						}
+						g_array_append_val(timestamps, pts);
+					}
+				}
+			}
+			if (job->error) {
+				// cancelled, the partial sheet is not cached
+			} else if (timestamps->len == 0) {
+				job->error = g_strdup("no keyframe could be decoded");
+			} else {
+				// pack the cells into a roughly square sprite sheet
+				int columns = 1;
+				while ((uint)(columns * columns) < timestamps->len) {
+					columns++;
+				}
+				int rows = (int)((timestamps->len + columns - 1) / columns);
+				GdkPixbuf* sheet = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, columns * w, rows * h);
+				gdk_pixbuf_fill(sheet, 0);
+				guchar* pixels = gdk_pixbuf_get_pixels(sheet);
+				int rowstride = gdk_pixbuf_get_rowstride(sheet);
+				for (uint i = 0; i < timestamps->len; i++) {
+					const guchar* cell = &cells->data[(size_t)i * stride * h];
+					guchar* dst = &pixels[(size_t)(i / columns) * h * rowstride + (size_t)(i % columns) * w * 3];
+					for (int y = 0; y < h; y++) {
+						// rgb0 to rgb
+						const guchar* src = &cell[(size_t)y * stride];
+						guchar* row = &dst[(size_t)y * rowstride];
+						for (int x = 0; x < w; x++) {
+							row[x * 3] = src[x * 4];
+							row[x * 3 + 1] = src[x * 4 + 1];
+							row[x * 3 + 2] = src[x * 4 + 2];
+						}
+					}
+				}
+				GError* error = NULL;
+				if (gdk_pixbuf_save(sheet, image, "jpeg", &error, "quality", "85", NULL)) {
+					GString* str = g_string_new(NULL);
+					g_string_append_printf(str, "%d %d %d %d\n", columns, rows, w, h);
+					for (uint i = 0; i < timestamps->len; i++) {
+						g_string_append_printf(str, "%ld\n", (long)g_array_index(timestamps, int64_t, i));
+					}
+					g_file_set_contents(index, str->str, (gssize)str->len, NULL);
+					g_string_free(str, TRUE);
+					job->result = av_media_player_thumbnail_result(image, columns, rows, w, h, timestamps);
+				} else {
+					job->error = g_strdup(error->message);
+					g_error_free(error);
+				}
+				g_object_unref(sheet);
+			}
+			g_byte_array_free(cells, TRUE);
+			g_array_free(timestamps, TRUE);
+		}
+	}
+	if (renderContext) {
+		mpv_render_context_free(renderContext);
+	}
+	mpv_destroy(mpv);
+}
+
+static gboolean av_media_player_thumbnail_respond(void* data) {
+	AvMediaPlayerThumbnailJob* job = data;
+	if (job->result) {
+		fl_method_call_respond_success(job->call, job->result, NULL);
+		fl_value_unref(job->result);
+	} else {
+		fl_method_call_respond_error(job->call, "thumbnails", job->error ? job->error : "unknown error", NULL, NULL);
+	}
+	g_object_unref(job->call);
+	g_free(job->source);
+	g_free(job->path);
+	g_free(job->error);
+	g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_thumbnail_run(gpointer data, gpointer user_data) {
+	AvMediaPlayerThumbnailJob* job = data;
+	gchar* key = av_media_player_thumbnail_key(job);
+	gchar* dir = g_build_filename(g_get_user_cache_dir(), "av_media_player", "thumbnails", NULL);
+	gchar* name = g_strdup_printf("%s.jpg", key);
+	gchar* image = g_build_filename(dir, name, NULL);
+	g_free(name);
+	name = g_strdup_printf("%s.idx", key);
+	gchar* index = g_build_filename(dir, name, NULL);
+	g_free(name);
+	if (g_atomic_int_get(&plugin->thumbnailCancelled)) {
+		job->error = g_strdup("plugin disposed");
+	} else {
+		av_media_player_thumbnail_load(job, image, index);
+	}
+	if (!job->result && !job->error) {
+		g_mkdir_with_parents(dir, 0755);
+		av_media_player_thumbnail_generate(job, image, index);
+	}
+	g_free(image);
+	g_free(index);
+	g_free(dir);
+	g_free(key);
+	g_idle_add(av_media_player_thumbnail_respond, job);
+}
+
+/* headless media probing, runs in worker threads with pooled mpv instances */
+typedef struct {
+	int64_t job;
+	int64_t index;
+	gchar* source;
+	gint* remaining; // shared by all sources of the same job
+	FlValue* result;
+} AvMediaPlayerProbeTask;
+
+static mpv_handle* av_media_player_probe_handle() {
+	mpv_handle* mpv = g_async_queue_try_pop(plugin->probeHandles);
+	if (!mpv) {
+		mpv = mpv_create();
+		mpv_set_property_string(mpv, "vo", "null");
+		mpv_set_property_string(mpv, "ao", "null");
+		mpv_set_property_string(mpv, "vid", "no"); // tracks are still listed without decoders
+		mpv_set_property_string(mpv, "aid", "no");
+		mpv_set_property_string(mpv, "sid", "no");
+		mpv_set_property_string(mpv, "pause", "yes");
+		mpv_set_property_string(mpv, "idle", "yes");
+		mpv_set_property_string(mpv, "cache", "no");
+		mpv_set_property_string(mpv, "demuxer-readahead-secs", "0");
+		mpv_set_property_string(mpv, "demuxer-lavf-probe-info", "nostreams");
+		mpv_set_property_string(mpv, "demuxer-lavf-analyzeduration", "0.5");
+		mpv_initialize(mpv);
+		av_media_player_stream_attach(mpv);
+	}
+	return mpv;
+}
+
+static FlValue* av_media_player_probe_path(const gchar* path, int* error) {
+	// returns the media info of path, or NULL with error set. it's called in worker threads
+	mpv_handle* mpv = av_media_player_probe_handle();
+	const gchar* load[] = { "loadfile", path, NULL };
+	int result = mpv_command(mpv, load);
+	FlValue* info = NULL;
+	if (result == 0 && av_media_player_wait_event(mpv, MPV_EVENT_FILE_LOADED, 30) == MPV_EVENT_FILE_LOADED) {
+		double duration = 0;
+		mpv_get_property(mpv, "duration/full", MPV_FORMAT_DOUBLE, &duration);
+		info = fl_value_new_map();
+		fl_value_set_string_take(info, "duration", fl_value_new_int((int64_t)(duration * 1000)));
+		fl_value_set_string_take(info, "tracks", read_tracks(mpv, NULL));
+	} else {
+		*error = result < 0 ? result : MPV_ERROR_LOADING_FAILED;
+	}
+	if (result == 0) {
+		// drain the events of this file, so the handle is clean for the next task
+		const gchar* stop[] = { "stop", NULL };
+		mpv_command(mpv, stop);
+		mpv_event* event;
+		do {
+			event = mpv_wait_event(mpv, 5);
+		} while (event->event_id != MPV_EVENT_IDLE && event->event_id != MPV_EVENT_NONE);
+	}
+	g_async_queue_push(plugin->probeHandles, mpv);
+	return info;
+}
+
+static gboolean av_media_player_probe_send(void* data) {
+	// called in the main thread, or in the worker once the plugin is disposed to just free the task
+	AvMediaPlayerProbeTask* task = data;
+	const gboolean cancelled = g_atomic_int_get(&plugin->probeCancelled);
+	if (!cancelled) {
+		fl_event_channel_send(plugin->probeChannel, task->result, NULL, NULL);
+	}
+	fl_value_unref(task->result);
+	if (g_atomic_int_dec_and_test(task->remaining)) {
+		if (!cancelled) {
+			g_autoptr(FlValue) evt = fl_value_new_map();
+			fl_value_set_string_take(evt, "job", fl_value_new_int(task->job));
+			fl_value_set_string_take(evt, "event", fl_value_new_string("done"));
+			fl_event_channel_send(plugin->probeChannel, evt, NULL, NULL);
+		}
+		g_free(task->remaining);
+	}
+	g_free(task->source);
+	g_free(task);
+	return G_SOURCE_REMOVE;
+}
+
+static void av_media_player_probe_finish(AvMediaPlayerProbeTask* task) {
+	// the main loop may outlive the channel once the plugin is disposed
+	if (g_atomic_int_get(&plugin->probeCancelled)) {
+		av_media_player_probe_send(task);
+	} else {
+		g_idle_add(av_media_player_probe_send, task);
+	}
+}
+
+static void av_media_player_probe_run(gpointer data, gpointer user_data) {
+	AvMediaPlayerProbeTask* task = data;
+	task->result = fl_value_new_map();
+	fl_value_set_string_take(task->result, "job", fl_value_new_int(task->job));
+	fl_value_set_string_take(task->result, "index", fl_value_new_int(task->index));
+	fl_value_set_string_take(task->result, "source", fl_value_new_string(task->source));
+	if (g_atomic_int_get(&plugin->probeCancelled)) {
+		av_media_player_probe_finish(task);
+		return;
+	}
+	gchar* path = resolve_source(task->source);
+	g_autofree gchar* identity = media_info_identity(path);
+	g_autoptr(FlValue) cached = identity ? media_info_load(identity) : NULL;
+	if (cached) {
+		g_free(path);
+		fl_value_set_string_take(task->result, "event", fl_value_new_string("mediaInfo"));
+		fl_value_set_string(task->result, "duration", fl_value_lookup_string(cached, "duration"));
+		fl_value_set_string(task->result, "tracks", fl_value_lookup_string(cached, "tracks"));
+		av_media_player_probe_finish(task);
+		return;
+	}
+	int error = 0;
+	g_autoptr(FlValue) info = av_media_player_probe_path(path, &error);
+	g_free(path);
+	if (info) {
+		fl_value_set_string_take(task->result, "event", fl_value_new_string("mediaInfo"));
+		fl_value_set_string(task->result, "duration", fl_value_lookup_string(info, "duration"));
+		fl_value_set_string(task->result, "tracks", fl_value_lookup_string(info, "tracks"));
+	} else {
+		fl_value_set_string_take(task->result, "event", fl_value_new_string("error"));
+		fl_value_set_string_take(task->result, "value", fl_value_new_string(mpv_error_string(error)));
+	}
+	av_media_player_probe_finish(task);
+}
+
+/* packs, many small media in one mapped file, see av_media_player_stream.c for the format */
+typedef struct {
+	FlMethodCall* call;
+	gchar* output;
+	gchar** names;
+	gchar** sources;
+	gboolean result;
+} AvMediaPlayerPackJob;
+
+static gboolean av_media_player_pack_respond(void* data) {
+	AvMediaPlayerPackJob* job = data;
+	g_autoptr(FlValue) result = fl_value_new_bool(job->result);
+	fl_method_call_respond_success(job->call, result, NULL);
+	g_object_unref(job->call);
+	g_free(job->output);
+	g_strfreev(job->names);
+	g_strfreev(job->sources);
+	g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static FlValue* av_media_player_pack_info(const gchar* path) {
+	// opens path the way a player does, so the info matches what the player reports after loading it.
+	// the probe handles are not used since they skip stream info and decoders
+	mpv_handle* mpv = mpv_create();
+	mpv_set_property_string(mpv, "vo", "null");
+	mpv_set_property_string(mpv, "ao", "null");
+	mpv_set_property_string(mpv, "pause", "yes");
+	mpv_set_property_string(mpv, "keep-open", "yes");
+	mpv_set_property_string(mpv, "idle", "yes");
+	mpv_initialize(mpv);
+	av_media_player_stream_attach(mpv);
+	const gchar* load[] = { "loadfile", path, NULL };
+	FlValue* info = NULL;
+	if (mpv_command(mpv, load) == 0 && av_media_player_wait_event(mpv, MPV_EVENT_FILE_LOADED, 30) == MPV_EVENT_FILE_LOADED) {
+		double duration = 0;
+		mpv_get_property(mpv, "duration/full", MPV_FORMAT_DOUBLE, &duration);
+		info = fl_value_new_map();
+		fl_value_set_string_take(info, "duration", fl_value_new_int((int64_t)(duration * 1000)));
+		fl_value_set_string_take(info, "tracks", read_tracks(mpv, NULL));
+	}
+	mpv_destroy(mpv);
+	return info;
+}
+
+static gpointer av_media_player_pack_run(gpointer data) {
+	// the media info of each source is stored in the pack, so opening them skips the media info cache
+	AvMediaPlayerPackJob* job = data;
+	guint count = g_strv_length(job->sources);
+	gchar** paths = g_new0(gchar*, count + 1);
+	GBytes** metas = g_new0(GBytes*, count);
+	g_autoptr(FlStandardMessageCodec) codec = fl_standard_message_codec_new();
+	for (guint i = 0; i < count; i++) {
+		paths[i] = resolve_source(job->sources[i]);
+		g_autoptr(FlValue) info = av_media_player_pack_info(paths[i]);
+		if (info) {
+			metas[i] = fl_message_codec_encode_message(FL_MESSAGE_CODEC(codec), info, NULL);
+		}
+	}
+	job->result = av_media_player_stream_write_pack(job->output, (const gchar* const*)job->names, (const gchar* const*)paths, metas);
+	for (guint i = 0; i < count; i++) {
+		if (metas[i]) {
+			g_bytes_unref(metas[i]);
+		}
+	}
+	g_free(metas);
+	g_strfreev(paths);
+	g_idle_add(av_media_player_pack_respond, job);
+	return NULL;
+}
+
+/* network warm up, the work is done in the http cache proxy */
+typedef struct {
+	FlMethodCall* call;
+	int64_t id;
+} AvMediaPlayerWarmUpJob;
+
+static gboolean av_media_player_warm_up_respond(void* data) {
+	AvMediaPlayerWarmUpJob* job = data;
+	GCancellable* cancellable = g_hash_table_lookup(plugin->warmUps, (gpointer)job->id);
+	g_autoptr(FlValue) result = fl_value_new_bool(!g_cancellable_is_cancelled(cancellable));
+	g_hash_table_remove(plugin->warmUps, (gpointer)job->id);
+	fl_method_call_respond_success(job->call, result, NULL);
+	g_object_unref(job->call);
+	g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static void cancel_warm_up(gpointer key, gpointer value, gpointer user_data) {
+	g_cancellable_cancel(value);
+}
+
 /* plugin implementation */
 static void av_media_player_plugin_clear(AvMediaPlayerPlugin* self) {
 	g_mutex_lock(&self->mutex);
 	g_tree_foreach(self->players, release_object_on_tree, NULL);
 	g_tree_remove_all(self->players);
 	g_mutex_unlock(&self->mutex);
+	g_hash_table_remove_all(self->walls);
 }
 
 static void av_media_player_plugin_dispose(GObject* object) {
@@ -617,6 +4035,36 @@ static void av_media_player_plugin_dispose(GObject* object) {
 	g_object_unref(self->methodChannel);
 	g_object_unref(self->codec);
 	g_tree_destroy(self->players);
+	g_hash_table_destroy(self->walls);
+	if (self->thumbnailPool) {
+		// the queued jobs still run, they see thumbnailCancelled and answer with an error
+		g_atomic_int_set(&self->thumbnailCancelled, 1);
+		g_thread_pool_free(self->thumbnailPool, FALSE, TRUE);
+		self->thumbnailPool = NULL;
+	}
+	if (self->probePool) {
+		// wait for the running probes, they and the queued ones see probeCancelled and skip the channel
+		g_atomic_int_set(&self->probeCancelled, 1);
+		g_thread_pool_free(self->probePool, FALSE, TRUE);
+		self->probePool = NULL;
+	}
+	if (self->infoPool) {
+		g_thread_pool_free(self->infoPool, FALSE, TRUE); // pending entries are still written
+		self->infoPool = NULL;
+	}
+	if (self->subtitlePool) {
+		// wait for the running job, it and the queued ones see subtitleCancelled and don't look for their player
+		g_atomic_int_set(&self->subtitleCancelled, 1);
+		g_thread_pool_free(self->subtitlePool, FALSE, TRUE);
+		self->subtitlePool = NULL;
+	}
+	if (self->snapshotPool) {
+		g_thread_pool_free(self->snapshotPool, TRUE, FALSE);
+		self->snapshotPool = NULL;
+	}
+	g_hash_table_foreach(self->warmUps, cancel_warm_up, NULL);
+	g_async_queue_unref(self->probeHandles);
+	g_object_unref(self->probeChannel);
 }
 
 static void av_media_player_plugin_class_init(AvMediaPlayerPluginClass* klass) {
@@ -626,6 +4074,18 @@ static void av_media_player_plugin_class_init(AvMediaPlayerPluginClass* klass) {
 static void av_media_player_plugin_init(AvMediaPlayerPlugin* self) {
 	self->codec = FL_METHOD_CODEC(fl_standard_method_codec_new());
 	self->players = g_tree_new(compare_key);
+	self->thumbnailPool = NULL;
+	self->thumbnailCancelled = 0;
+	self->probePool = NULL;
+	self->probeCancelled = 0;
+	self->infoPool = NULL;
+	self->subtitlePool = NULL;
+	self->subtitleCancelled = 0;
+	self->snapshotPool = NULL;
+	self->warmUps = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+	self->walls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, av_media_player_wall_release);
+	self->probeHandles = g_async_queue_new_full((GDestroyNotify)mpv_destroy);
+	self->probeJobs = 0;
 	g_mutex_init(&self->mutex);
 	printf("mutex init: %p\n", &self->mutex);
 }
@@ -642,6 +4102,7 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 		g_mutex_unlock(&self->mutex);
 		g_autoptr(FlValue) result = fl_value_new_map();
 		fl_value_set_string_take(result, "id", fl_value_new_int(player->id));
+		fl_value_set_string_take(result, "subId", fl_value_new_int(fl_texture_get_id(FL_TEXTURE(player->subtitle))));
 		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 	} else if (strcmp(method, "dispose") == 0) {
 		if (fl_value_get_type(args) == FL_VALUE_TYPE_NULL) {
@@ -653,10 +4114,54 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 			g_tree_remove(self->players, id);
 			g_mutex_unlock(&self->mutex);
 		}
+	} else if (strcmp(method, "createWall") == 0) {
+		const uint16_t columns = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "columns"));
+		const uint16_t rows = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "rows"));
+		const uint16_t tileWidth = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "tileWidth"));
+		const uint16_t tileHeight = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "tileHeight"));
+		AvMediaPlayerWall* wall = av_media_player_wall_new(self->textureRegistrar, columns, rows, tileWidth, tileHeight);
+		const int64_t id = fl_texture_get_id(FL_TEXTURE(wall));
+		g_hash_table_insert(self->walls, (gpointer)id, wall);
+		g_autoptr(FlValue) result = fl_value_new_int(id);
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "setWallTile") == 0) {
+		AvMediaPlayerWall* wall = g_hash_table_lookup(self->walls, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int index = (int)fl_value_get_int(fl_value_lookup_string(args, "index"));
+		FlValue* player = fl_value_lookup_string(args, "player");
+		if (wall) {
+			av_media_player_wall_set_tile(wall, index, fl_value_get_type(player) == FL_VALUE_TYPE_INT ? (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(player)) : NULL);
+		}
+	} else if (strcmp(method, "disposeWall") == 0) {
+		g_hash_table_remove(self->walls, (gpointer)fl_value_get_int(args));
 	} else if (strcmp(method, "open") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const gchar* value = fl_value_get_string(fl_value_lookup_string(args, "value"));
-		av_media_player_open(player, value);
+		FlValue* probeSize = fl_value_lookup_string(args, "probeSize");
+		FlValue* analyzeDuration = fl_value_lookup_string(args, "analyzeDuration");
+		FlValue* probeInfo = fl_value_lookup_string(args, "probeInfo");
+		FlValue* format = fl_value_lookup_string(args, "format");
+		int result = av_media_player_set_probe(player,
+			probeSize ? fl_value_get_int(probeSize) : 0,
+			analyzeDuration ? fl_value_get_int(analyzeDuration) : 0,
+			probeInfo ? fl_value_get_string(probeInfo) : NULL,
+			format ? fl_value_get_string(format) : NULL);
+		FlValue* clipMaxDuration = fl_value_lookup_string(args, "clipMaxDuration");
+		if (result < 0) {
+			// invalid probe options fail the open like an invalid source
+			av_media_player_close(player);
+			g_autoptr(FlValue) evt = fl_value_new_map();
+			fl_value_set_string_take(evt, "event", fl_value_new_string("error"));
+			fl_value_set_string_take(evt, "value", fl_value_new_string(mpv_error_string(result)));
+			fl_event_channel_send(player->eventChannel, evt, NULL, NULL);
+		} else if (clipMaxDuration) {
+			const uint16_t width = (uint16_t)fl_value_get_float(fl_value_lookup_string(args, "clipMaxWidth"));
+			const uint16_t height = (uint16_t)fl_value_get_float(fl_value_lookup_string(args, "clipMaxHeight"));
+			const uint16_t frameWidth = (uint16_t)fl_value_get_float(fl_value_lookup_string(args, "clipFrameWidth"));
+			const uint16_t frameHeight = (uint16_t)fl_value_get_float(fl_value_lookup_string(args, "clipFrameHeight"));
+			av_media_player_open(player, value, fl_value_get_int(clipMaxDuration), width, height, frameWidth, frameHeight);
+		} else {
+			av_media_player_open(player, value, 0, 0, 0, 0, 0);
+		}
 	} else if (strcmp(method, "close") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(args));
 		av_media_player_close(player);
@@ -670,6 +4175,10 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const int64_t value = fl_value_get_int(fl_value_lookup_string(args, "value"));
 		av_media_player_seek_to(player, value);
+	} else if (strcmp(method, "setScrubbing") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const bool value = fl_value_get_bool(fl_value_lookup_string(args, "value"));
+		av_media_player_set_scrubbing(player, value);
 	} else if (strcmp(method, "setVolume") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const double value = fl_value_get_float(fl_value_lookup_string(args, "value"));
@@ -678,10 +4187,45 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const double value = fl_value_get_float(fl_value_lookup_string(args, "value"));
 		av_media_player_set_speed(player, value);
+	} else if (strcmp(method, "stepFrame") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int direction = (int)fl_value_get_int(fl_value_lookup_string(args, "value"));
+		av_media_player_step_frame(player, direction, method_call);
+		return; // responded in av_media_player_step_respond
+	} else if (strcmp(method, "snapshot") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const uint8_t format = (uint8_t)fl_value_get_int(fl_value_lookup_string(args, "format"));
+		const uint16_t maxSize = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "maxSize"));
+		av_media_player_snapshot(player, format, maxSize, method_call);
+		return; // responded in av_media_player_snapshot_respond
+	} else if (strcmp(method, "setFrameTap") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const double frameRate = fl_value_get_float(fl_value_lookup_string(args, "frameRate"));
+		const uint16_t maxSize = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "maxSize"));
+		const uint32_t format = (uint32_t)fl_value_get_int(fl_value_lookup_string(args, "format"));
+		av_media_player_set_frame_tap(player, frameRate, maxSize, format);
+	} else if (strcmp(method, "addMirror") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const uint16_t maxWidth = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "maxWidth"));
+		const uint16_t maxHeight = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "maxHeight"));
+		g_autoptr(FlValue) result = fl_value_new_int(av_media_player_add_mirror(player, maxWidth, maxHeight));
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "removeMirror") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		av_media_player_remove_mirror(player, fl_value_get_int(fl_value_lookup_string(args, "value")));
+	} else if (strcmp(method, "setTrickPlay") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const double value = fl_value_get_float(fl_value_lookup_string(args, "value"));
+		av_media_player_set_trick_play(player, value);
 	} else if (strcmp(method, "setLooping") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const bool value = fl_value_get_bool(fl_value_lookup_string(args, "value"));
 		av_media_player_set_looping(player, value);
+	} else if (strcmp(method, "setLoopRange") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int64_t begin = fl_value_get_int(fl_value_lookup_string(args, "begin"));
+		const int64_t end = fl_value_get_int(fl_value_lookup_string(args, "end"));
+		av_media_player_set_loop_range(player, begin, end);
 	} else if (strcmp(method, "setShowSubtitle") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const bool value = fl_value_get_bool(fl_value_lookup_string(args, "value"));
@@ -698,6 +4242,29 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const uint32_t value = (uint32_t)fl_value_get_int(fl_value_lookup_string(args, "value"));
 		av_media_player_set_max_bitrate(player, value);
+	} else if (strcmp(method, "setReconnect") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int maxAttempts = (int)fl_value_get_int(fl_value_lookup_string(args, "maxAttempts"));
+		const int64_t delay = fl_value_get_int(fl_value_lookup_string(args, "initialDelay"));
+		const int64_t maxDelay = fl_value_get_int(fl_value_lookup_string(args, "maxDelay"));
+		av_media_player_set_reconnect(player, maxAttempts, delay, maxDelay);
+	} else if (strcmp(method, "setTimeshift") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int64_t value = fl_value_get_int(fl_value_lookup_string(args, "value"));
+		av_media_player_set_timeshift(player, value);
+	} else if (strcmp(method, "setLowLatency") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const int64_t target = fl_value_get_int(fl_value_lookup_string(args, "targetLatency"));
+		const int64_t maxLatency = fl_value_get_int(fl_value_lookup_string(args, "maxLatency"));
+		const double maxRate = fl_value_get_float(fl_value_lookup_string(args, "maxSpeedChange"));
+		av_media_player_set_low_latency(player, target, maxLatency, maxRate);
+	} else if (strcmp(method, "setAbr") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		const bool enabled = fl_value_get_bool(fl_value_lookup_string(args, "enabled"));
+		const double safety = fl_value_get_float(fl_value_lookup_string(args, "safetyFactor"));
+		const int64_t upBuffer = fl_value_get_int(fl_value_lookup_string(args, "upswitchBuffer"));
+		const int64_t interval = fl_value_get_int(fl_value_lookup_string(args, "switchInterval"));
+		av_media_player_set_abr(player, enabled, safety, upBuffer, interval);
 	} else if (strcmp(method, "setMaxResolution") == 0) {
 		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
 		const uint16_t width = (uint16_t)fl_value_get_float(fl_value_lookup_string(args, "width"));
@@ -709,6 +4276,145 @@ static void av_media_player_plugin_method_call(FlMethodChannel* channel, FlMetho
 		uint16_t trackId = (uint16_t)fl_value_get_int(fl_value_lookup_string(args, "trackId"));
 		const bool enabled = fl_value_get_bool(fl_value_lookup_string(args, "value"));
 		av_media_player_overrideTrack(player, typeId, trackId, enabled);
+	} else if (strcmp(method, "addSubtitle") == 0) {
+		AvMediaPlayer* player = (AvMediaPlayer*)g_tree_lookup(self->players, (gpointer)fl_value_get_int(fl_value_lookup_string(args, "id")));
+		if (!self->subtitlePool) {
+			self->subtitlePool = g_thread_pool_new(av_media_player_subtitle_file_run, NULL, 1, FALSE, NULL);
+		}
+		const gchar* language = fl_value_get_string(fl_value_lookup_string(args, "language"));
+		AvMediaPlayerSubtitleJob* job = g_new0(AvMediaPlayerSubtitleJob, 1);
+		job->call = g_object_ref(method_call);
+		job->id = player->id;
+		job->source = g_strdup(player->source);
+		job->path = resolve_source(fl_value_get_string(fl_value_lookup_string(args, "source")));
+		job->language = language[0] ? g_strdup(language) : NULL;
+		g_thread_pool_push(self->subtitlePool, job, NULL);
+		return; // responded in av_media_player_subtitle_file_respond
+	} else if (strcmp(method, "generateThumbnails") == 0) {
+		if (!self->thumbnailPool) {
+			// keep some cores for the foreground players
+			self->thumbnailPool = g_thread_pool_new(av_media_player_thumbnail_run, NULL, MAX(g_get_num_processors() / 2, 1), FALSE, NULL);
+		}
+		AvMediaPlayerThumbnailJob* job = g_new0(AvMediaPlayerThumbnailJob, 1);
+		job->call = g_object_ref(method_call);
+		job->source = g_strdup(fl_value_get_string(fl_value_lookup_string(args, "source")));
+		job->path = resolve_source(job->source);
+		job->interval = MAX(fl_value_get_int(fl_value_lookup_string(args, "interval")), 100);
+		job->width = (uint16_t)CLAMP(fl_value_get_float(fl_value_lookup_string(args, "width")), 16, AV_MEDIA_PLAYER_THUMBNAIL_MAX_SIZE);
+		job->height = (uint16_t)CLAMP(fl_value_get_float(fl_value_lookup_string(args, "height")), 16, AV_MEDIA_PLAYER_THUMBNAIL_MAX_SIZE);
+		g_thread_pool_push(self->thumbnailPool, job, NULL);
+		return; // responded in av_media_player_thumbnail_respond
+	} else if (strcmp(method, "probe") == 0) {
+		if (!self->probePool) {
+			self->probePool = g_thread_pool_new(av_media_player_probe_run, NULL, MAX(g_get_num_processors(), 2), FALSE, NULL);
+		}
+		size_t count = fl_value_get_length(args);
+		int64_t job = ++self->probeJobs;
+		if (count > 0) {
+			gint* remaining = g_new(gint, 1);
+			*remaining = (gint)count;
+			for (size_t i = 0; i < count; i++) {
+				AvMediaPlayerProbeTask* task = g_new0(AvMediaPlayerProbeTask, 1);
+				task->job = job;
+				task->index = (int64_t)i;
+				task->source = g_strdup(fl_value_get_string(fl_value_get_list_value(args, i)));
+				task->remaining = remaining;
+				g_thread_pool_push(self->probePool, task, NULL);
+			}
+		}
+		g_autoptr(FlValue) result = fl_value_new_int(job);
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "allocateMemorySource") == 0) {
+		gchar* url = NULL;
+		void* data = av_media_player_stream_alloc(fl_value_get_int(args), &url);
+		g_autoptr(FlValue) result = data ? fl_value_new_map() : fl_value_new_null();
+		if (data) {
+			fl_value_set_string_take(result, "url", fl_value_new_string(url));
+			fl_value_set_string_take(result, "address", fl_value_new_int((int64_t)(intptr_t)data));
+			g_free(url);
+		}
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "addEncryptedSource") == 0) {
+		gchar* path = resolve_source(fl_value_get_string(fl_value_lookup_string(args, "path")));
+		FlValue* key = fl_value_lookup_string(args, "key");
+		FlValue* iv = fl_value_lookup_string(args, "iv");
+		g_autofree gchar* url = fl_value_get_length(iv) == 16 ? av_media_player_stream_add_encrypted(path, fl_value_get_uint8_list(key), (int)fl_value_get_length(key), fl_value_get_uint8_list(iv)) : NULL;
+		g_free(path);
+		g_autoptr(FlValue) result = url ? fl_value_new_string(url) : fl_value_new_null();
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "createPack") == 0) {
+		FlValue* files = fl_value_lookup_string(args, "files");
+		size_t count = fl_value_get_length(files);
+		AvMediaPlayerPackJob* job = g_new0(AvMediaPlayerPackJob, 1);
+		job->call = g_object_ref(method_call);
+		job->output = g_strdup(fl_value_get_string(fl_value_lookup_string(args, "output")));
+		job->names = g_new0(gchar*, count + 1);
+		job->sources = g_new0(gchar*, count + 1);
+		for (size_t i = 0; i < count; i++) {
+			job->names[i] = g_strdup(fl_value_get_string(fl_value_get_map_key(files, i)));
+			job->sources[i] = g_strdup(fl_value_get_string(fl_value_get_map_value(files, i)));
+		}
+		g_thread_unref(g_thread_new("av_media_player_pack", av_media_player_pack_run, job));
+		return;
+	} else if (strcmp(method, "loadPack") == 0) {
+		gchar* path = resolve_source(fl_value_get_string(args));
+		g_autoptr(FlValue) result = fl_value_new_int(av_media_player_stream_load_pack(path));
+		g_free(path);
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "unloadPack") == 0) {
+		gchar* path = resolve_source(fl_value_get_string(args));
+		av_media_player_stream_unload_pack(path);
+		g_free(path);
+	} else if (strcmp(method, "releaseSource") == 0) {
+		av_media_player_stream_release(fl_value_get_string(args));
+	} else if (strcmp(method, "setHttpCache") == 0) {
+		g_autoptr(FlValue) result = fl_value_new_bool(av_media_player_proxy_set_max_size(fl_value_get_int(args)));
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "warmUp") == 0) {
+		FlValue* list = fl_value_lookup_string(args, "urls");
+		size_t count = fl_value_get_length(list);
+		const gchar** urls = g_new0(const gchar*, count + 1);
+		for (size_t i = 0; i < count; i++) {
+			urls[i] = fl_value_get_string(fl_value_get_list_value(list, i));
+		}
+		AvMediaPlayerWarmUpJob* job = g_new(AvMediaPlayerWarmUpJob, 1);
+		job->call = g_object_ref(method_call);
+		job->id = fl_value_get_int(fl_value_lookup_string(args, "id"));
+		g_autoptr(GCancellable) cancellable = g_cancellable_new();
+		gboolean started = av_media_player_proxy_warm_up(
+			urls,
+			fl_value_get_int(fl_value_lookup_string(args, "prefetchBytes")),
+			(int)fl_value_get_int(fl_value_lookup_string(args, "prefetchSegments")),
+			(int)fl_value_get_int(fl_value_lookup_string(args, "concurrency")),
+			fl_value_get_int(fl_value_lookup_string(args, "maxBytes")),
+			cancellable,
+			av_media_player_warm_up_respond,
+			job);
+		g_free(urls);
+		if (started) {
+			g_hash_table_insert(self->warmUps, (gpointer)job->id, g_object_ref(cancellable));
+			return; // responded in av_media_player_warm_up_respond
+		}
+		g_object_unref(job->call);
+		g_free(job);
+		g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+	} else if (strcmp(method, "cancelWarmUp") == 0) {
+		GCancellable* cancellable = g_hash_table_lookup(self->warmUps, (gpointer)fl_value_get_int(args));
+		if (cancellable) {
+			g_cancellable_cancel(cancellable);
+		}
+	} else if (strcmp(method, "getHttpCacheStats") == 0) {
+		AvMediaPlayerProxyStats stats;
+		av_media_player_proxy_get_stats(&stats);
+		g_autoptr(FlValue) result = fl_value_new_map();
+		fl_value_set_string_take(result, "size", fl_value_new_int(stats.size));
+		fl_value_set_string_take(result, "maxSize", fl_value_new_int(stats.maxSize));
+		fl_value_set_string_take(result, "hitBytes", fl_value_new_int(stats.hitBytes));
+		fl_value_set_string_take(result, "missBytes", fl_value_new_int(stats.missBytes));
+		fl_value_set_string_take(result, "requests", fl_value_new_int(stats.requests));
+		fl_value_set_string_take(result, "objects", fl_value_new_int(stats.objects));
+		response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 	} else {
 		response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
 	}
@@ -726,5 +4432,6 @@ void av_media_player_plugin_register_with_registrar(FlPluginRegistrar* registrar
 	plugin->messenger = fl_plugin_registrar_get_messenger(registrar);
 	plugin->textureRegistrar = fl_plugin_registrar_get_texture_registrar(registrar);
 	plugin->methodChannel = fl_method_channel_new(plugin->messenger, "av_media_player", plugin->codec);
+	plugin->probeChannel = fl_event_channel_new(plugin->messenger, "av_media_player/probe", plugin->codec);
 	fl_method_channel_set_method_call_handler(plugin->methodChannel, av_media_player_plugin_method_call, plugin, g_object_unref);
 }
\ No newline at end of file
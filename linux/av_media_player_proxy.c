@@ -0,0 +1,1155 @@
+#include "av_media_player_proxy.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PROXY_CHUNK 65536
+#define PROXY_WAIT_WINDOW (1 << 20) // a reader this close behind a running download waits for it instead of downloading the same bytes
+#define PROXY_WAIT_TIMEOUT (15 * G_TIME_SPAN_SECOND)
+#define PROXY_MAX_REDIRECTS 5
+#define PROXY_MAX_PLAYLIST (16 << 20)
+#define PROXY_MAX_IDLE 4 // idle connections kept per host
+#define PROXY_IDLE_TIMEOUT (30 * G_TIME_SPAN_SECOND)
+
+typedef struct {
+	gchar* url;
+	gchar* name; // sha1 of url, used for the file names
+	gchar* contentType;
+	gchar* etag;
+	gchar* lastModified;
+	GArray* ranges;     // cached bytes as sorted pairs of begin and end
+	GPtrArray* fetches; // running downloads, see AvMediaPlayerProxyFetch
+	int64_t size;
+	int64_t cached;   // total length of ranges
+	int64_t lastUsed; // real time in microseconds
+	int readers;
+	bool dirty; // the meta file is outdated
+} AvMediaPlayerProxyObject;
+
+typedef struct {
+	int64_t pos; // next byte to be written
+	int64_t end;
+} AvMediaPlayerProxyFetch;
+
+typedef struct {
+	GSocketConnection* connection;
+	gint64 time; // monotonic time when the connection became idle
+} AvMediaPlayerProxyIdle;
+
+typedef struct {
+	GSocketConnection* connection;
+	GDataInputStream* in;
+	GCancellable* cancellable;
+	gchar* key; // scheme and authority, used to pool the connection
+	gchar* url; // the url after redirects
+	gchar* contentType;
+	gchar* etag;
+	gchar* lastModified;
+	int status;
+	int64_t length; // bytes left in the body, -1 if unknown
+	int64_t begin;  // offset of the body in the object
+	int64_t total;  // size of the object, -1 if unknown
+	int64_t chunk;  // bytes left in the current chunk, -1 after the last chunk
+	bool chunked;
+	bool reusable; // the server keeps the connection alive
+} AvMediaPlayerProxyResponse;
+
+typedef struct {
+	gchar** urls;
+	GCancellable* cancellable;
+	GSourceFunc callback;
+	gpointer data;
+	int64_t prefetchBytes;
+	int64_t budget; // bytes left to download, guarded by the mutex
+	int prefetchSegments;
+	int concurrency;
+} AvMediaPlayerProxyWarmUp;
+
+static struct {
+	GMutex mutex; // guards everything below, and all objects
+	GCond cond;   // signaled when a download makes progress or ends
+	GSocketService* service;
+	GSocketClient* client;
+	GSocketClient* tlsClient;
+	GHashTable* objects; // url to object
+	GHashTable* pool;    // scheme and authority to a GQueue of AvMediaPlayerProxyIdle
+	gchar* dir;
+	int64_t maxSize;
+	int64_t size;
+	int64_t hitBytes;
+	int64_t missBytes;
+	int64_t requests;
+	uint16_t port;
+	gchar* token; // random first path segment of proxied urls, requests without it are rejected
+	bool enabled;
+} proxy;
+
+/* byte ranges */
+static void range_add(GArray* ranges, int64_t begin, int64_t end) {
+	// keeps the pairs sorted, and merges the ones that overlap or touch
+	guint i = 0;
+	while (i < ranges->len / 2 && g_array_index(ranges, int64_t, i * 2 + 1) < begin) {
+		i++;
+	}
+	guint j = i;
+	while (j < ranges->len / 2 && g_array_index(ranges, int64_t, j * 2) <= end) {
+		begin = MIN(begin, g_array_index(ranges, int64_t, j * 2));
+		end = MAX(end, g_array_index(ranges, int64_t, j * 2 + 1));
+		j++;
+	}
+	g_array_remove_range(ranges, i * 2, (j - i) * 2);
+	int64_t pair[] = { begin, end };
+	g_array_insert_vals(ranges, i * 2, pair, 2);
+}
+
+static bool range_lookup(GArray* ranges, int64_t pos, int64_t* limit) {
+	// limit is set to the end of the range containing pos, otherwise to the begin of the next range or -1
+	for (guint i = 0; i < ranges->len / 2; i++) {
+		if (pos < g_array_index(ranges, int64_t, i * 2)) {
+			*limit = g_array_index(ranges, int64_t, i * 2);
+			return false;
+		} else if (pos < g_array_index(ranges, int64_t, i * 2 + 1)) {
+			*limit = g_array_index(ranges, int64_t, i * 2 + 1);
+			return true;
+		}
+	}
+	*limit = -1;
+	return false;
+}
+
+static int64_t range_length(GArray* ranges) {
+	int64_t length = 0;
+	for (guint i = 0; i < ranges->len / 2; i++) {
+		length += g_array_index(ranges, int64_t, i * 2 + 1) - g_array_index(ranges, int64_t, i * 2);
+	}
+	return length;
+}
+
+/* urls */
+static gchar* proxy_normalize(gchar* url) {
+	// removes dot segments from the path, takes the ownership of url
+	gchar* authority = strstr(url, "://") + 3;
+	gchar* path = authority + strcspn(authority, "/?#");
+	gsize length = strcspn(path, "?#");
+	if (!g_strstr_len(path, length, "/.")) {
+		return url;
+	}
+	g_autofree gchar* str = g_strndup(path, length);
+	gchar** segments = g_strsplit(str, "/", -1);
+	GPtrArray* result = g_ptr_array_new();
+	for (guint i = 0; segments[i]; i++) {
+		if (g_str_equal(segments[i], "..")) {
+			if (result->len > 1) {
+				g_ptr_array_remove_index(result, result->len - 1);
+			}
+		} else if (!g_str_equal(segments[i], ".")) {
+			g_ptr_array_add(result, segments[i]);
+		}
+	}
+	g_ptr_array_add(result, NULL);
+	g_autofree gchar* joined = g_strjoinv("/", (gchar**)result->pdata);
+	g_autofree gchar* origin = g_strndup(url, path - url);
+	gchar* normalized = g_strconcat(origin, joined, path + length, NULL);
+	g_ptr_array_free(result, TRUE);
+	g_strfreev(segments);
+	g_free(url);
+	return normalized;
+}
+
+static gchar* proxy_resolve(const gchar* base, const gchar* ref) {
+	if (strstr(ref, "://")) {
+		return g_strdup(ref);
+	}
+	const gchar* authority = strstr(base, "://") + 3;
+	const gchar* path = authority + strcspn(authority, "/?#");
+	if (g_str_has_prefix(ref, "//")) {
+		g_autofree gchar* scheme = g_strndup(base, authority - 3 - base);
+		return proxy_normalize(g_strconcat(scheme, ":", ref, NULL));
+	} else if (ref[0] == '/') {
+		g_autofree gchar* origin = g_strndup(base, path - base);
+		return proxy_normalize(g_strconcat(origin, ref, NULL));
+	}
+	const gchar* dir = path + strcspn(path, "?#");
+	while (dir > path && dir[-1] != '/') {
+		dir--;
+	}
+	g_autofree gchar* prefix = g_strndup(base, dir - base);
+	return proxy_normalize(g_strconcat(prefix, dir > path ? "" : "/", ref, NULL));
+}
+
+static gchar* proxy_url(const gchar* url) {
+	// the original url is kept escaped in the first path segment, the file name is repeated after it so
+	// demuxers still see the extension
+	const gchar* authority = strstr(url, "://") + 3;
+	const gchar* path = authority + strcspn(authority, "/?#");
+	const gchar* end = path + strcspn(path, "?#");
+	const gchar* name = end;
+	while (name > path && name[-1] != '/') {
+		name--;
+	}
+	g_autofree gchar* escaped = g_uri_escape_string(url, NULL, FALSE);
+	g_autofree gchar* file = g_strndup(name, end - name);
+	g_autofree gchar* escapedFile = g_uri_escape_string(file, NULL, FALSE);
+	return g_strdup_printf("http://127.0.0.1:%d/%s/%s/%s", proxy.port, proxy.token, escaped, escapedFile);
+}
+
+static bool proxy_is_http(const gchar* url) {
+	return g_str_has_prefix(url, "http://") || g_str_has_prefix(url, "https://");
+}
+
+/* upstream connections */
+static GSocketConnection* proxy_pool_take(const gchar* key) {
+	// returns the most recently used idle connection that is still healthy
+	GSocketConnection* result = NULL;
+	gint64 now = g_get_monotonic_time();
+	g_mutex_lock(&proxy.mutex);
+	GQueue* queue = g_hash_table_lookup(proxy.pool, key);
+	while (!result && queue && !g_queue_is_empty(queue)) {
+		AvMediaPlayerProxyIdle* idle = g_queue_pop_tail(queue);
+		GSocket* socket = g_socket_connection_get_socket(idle->connection);
+		if (now - idle->time < PROXY_IDLE_TIMEOUT && !g_socket_condition_check(socket, G_IO_IN | G_IO_HUP | G_IO_ERR)) {
+			result = idle->connection;
+		} else {
+			// closed by the server, or sent something we didn't ask for
+			g_object_unref(idle->connection);
+		}
+		g_free(idle);
+	}
+	g_mutex_unlock(&proxy.mutex);
+	return result;
+}
+
+static void proxy_pool_put(const gchar* key, GSocketConnection* connection) {
+	gint64 now = g_get_monotonic_time();
+	g_mutex_lock(&proxy.mutex);
+	GQueue* queue = g_hash_table_lookup(proxy.pool, key);
+	if (!queue) {
+		queue = g_queue_new();
+		g_hash_table_insert(proxy.pool, g_strdup(key), queue);
+	}
+	while (!g_queue_is_empty(queue) && (queue->length >= PROXY_MAX_IDLE || now - ((AvMediaPlayerProxyIdle*)g_queue_peek_head(queue))->time >= PROXY_IDLE_TIMEOUT)) {
+		AvMediaPlayerProxyIdle* idle = g_queue_pop_head(queue);
+		g_object_unref(idle->connection);
+		g_free(idle);
+	}
+	AvMediaPlayerProxyIdle* idle = g_new(AvMediaPlayerProxyIdle, 1);
+	idle->connection = connection;
+	idle->time = now;
+	g_queue_push_tail(queue, idle);
+	g_mutex_unlock(&proxy.mutex);
+}
+
+static gchar* proxy_key(const gchar* url) {
+	const gchar* authority = strstr(url, "://") + 3;
+	return g_strndup(url, authority + strcspn(authority, "/?#") - url);
+}
+
+static GSocketConnection* proxy_connect(const gchar* url, GCancellable* cancellable) {
+	// dns resolution, tcp and tls handshakes all happen here
+	bool tls = g_str_has_prefix(url, "https://");
+	g_autoptr(GSocketConnectable) address = g_network_address_parse_uri(url, tls ? 443 : 80, NULL);
+	return address ? g_socket_client_connect(tls ? proxy.tlsClient : proxy.client, address, cancellable, NULL) : NULL;
+}
+
+/* upstream requests */
+static void proxy_response_free(AvMediaPlayerProxyResponse* response) {
+	// the connection is pooled if the whole body was read
+	bool done = response->chunked ? response->chunk < 0 : response->length == 0;
+	if (response->connection && response->reusable && done && !g_cancellable_is_cancelled(response->cancellable) && g_buffered_input_stream_get_available(G_BUFFERED_INPUT_STREAM(response->in)) == 0) {
+		g_filter_input_stream_set_close_base_stream(G_FILTER_INPUT_STREAM(response->in), FALSE);
+		g_clear_object(&response->in);
+		proxy_pool_put(response->key, response->connection);
+	} else if (response->connection) {
+		g_clear_object(&response->in);
+		g_io_stream_close(G_IO_STREAM(response->connection), NULL, NULL);
+		g_object_unref(response->connection);
+	}
+	g_free(response->key);
+	g_free(response->url);
+	g_free(response->contentType);
+	g_free(response->etag);
+	g_free(response->lastModified);
+	g_free(response);
+}
+
+static void proxy_set_header(gchar** field, const gchar* value) {
+	g_free(*field);
+	*field = g_strdup(value);
+}
+
+static AvMediaPlayerProxyResponse* proxy_request(const gchar* url, int64_t begin, int64_t end, GCancellable* cancellable) {
+	// end is exclusive, -1 for the end of the object. returns NULL on errors or unexpected status
+	g_autofree gchar* current = g_strdup(url);
+	for (int redirects = 0; redirects <= PROXY_MAX_REDIRECTS; redirects++) {
+		const gchar* authority = strstr(current, "://") + 3;
+		const gchar* path = authority + strcspn(authority, "/?#");
+		g_autofree gchar* host = g_strndup(authority, path - authority);
+		g_autofree gchar* target = path[0] == '/' ? g_strndup(path, strcspn(path, "#")) : g_strconcat("/", path, NULL);
+		g_autofree gchar* key = proxy_key(current);
+		GSocketConnection* connection = proxy_pool_take(key);
+		bool pooled = connection != NULL;
+		if (!connection) {
+			connection = proxy_connect(current, cancellable);
+		}
+		if (!connection) {
+			break;
+		}
+		AvMediaPlayerProxyResponse* response = g_new0(AvMediaPlayerProxyResponse, 1);
+		response->connection = connection;
+		response->cancellable = cancellable;
+		response->key = g_steal_pointer(&key);
+		response->url = g_strdup(current);
+		response->length = -1;
+		response->total = -1;
+		response->in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+		g_data_input_stream_set_newline_type(response->in, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+		g_autoptr(GString) request = g_string_new(NULL);
+		g_string_append_printf(request, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: av_media_player\r\nAccept: */*\r\nAccept-Encoding: identity\r\n", target, host);
+		if (end >= 0) {
+			g_string_append_printf(request, "Range: bytes=%" G_GINT64_FORMAT "-%" G_GINT64_FORMAT "\r\n", begin, end - 1);
+		} else if (begin > 0) {
+			g_string_append_printf(request, "Range: bytes=%" G_GINT64_FORMAT "-\r\n", begin);
+		}
+		g_string_append(request, "\r\n");
+		g_autofree gchar* location = NULL;
+		bool ok = g_output_stream_write_all(g_io_stream_get_output_stream(G_IO_STREAM(connection)), request->str, request->len, NULL, cancellable, NULL);
+		gchar* line = ok ? g_data_input_stream_read_line(response->in, NULL, cancellable, NULL) : NULL;
+		ok = line && sscanf(line, "HTTP/%*d.%*d %d", &response->status) == 1;
+		response->reusable = ok && g_str_has_prefix(line, "HTTP/1.1");
+		if (!ok && pooled && !g_cancellable_is_cancelled(cancellable)) {
+			// the server closed the idle connection meanwhile, try again without counting it as a redirect
+			g_free(line);
+			proxy_response_free(response);
+			redirects--;
+			continue;
+		}
+		while (ok) {
+			g_free(line);
+			line = g_data_input_stream_read_line(response->in, NULL, cancellable, NULL);
+			if (!line || !line[0]) {
+				ok = line != NULL;
+				break;
+			}
+			gchar* value = strchr(line, ':');
+			if (!value) {
+				continue;
+			}
+			*value++ = 0;
+			value = g_strstrip(value);
+			if (!g_ascii_strcasecmp(line, "Content-Length")) {
+				response->length = g_ascii_strtoll(value, NULL, 10);
+			} else if (!g_ascii_strcasecmp(line, "Content-Range") && g_str_has_prefix(value, "bytes ")) {
+				gchar* total = strchr(value, '/');
+				response->begin = g_ascii_strtoll(value + 6, NULL, 10);
+				response->total = total && total[1] != '*' ? g_ascii_strtoll(total + 1, NULL, 10) : -1;
+			} else if (!g_ascii_strcasecmp(line, "Connection")) {
+				response->reusable = response->reusable && g_ascii_strcasecmp(value, "close");
+			} else if (!g_ascii_strcasecmp(line, "Transfer-Encoding")) {
+				response->chunked = g_strrstr(value, "chunked") != NULL;
+			} else if (!g_ascii_strcasecmp(line, "Content-Type")) {
+				proxy_set_header(&response->contentType, value);
+			} else if (!g_ascii_strcasecmp(line, "ETag")) {
+				proxy_set_header(&response->etag, value);
+			} else if (!g_ascii_strcasecmp(line, "Last-Modified")) {
+				proxy_set_header(&response->lastModified, value);
+			} else if (!g_ascii_strcasecmp(line, "Location")) {
+				proxy_set_header(&location, value);
+			}
+		}
+		g_free(line);
+		if (ok && location && response->status >= 300 && response->status < 400) {
+			g_free(current);
+			current = proxy_resolve(response->url, location);
+			proxy_response_free(response);
+			continue;
+		} else if (ok && (response->status == 200 || response->status == 206)) {
+			if (response->status == 200) {
+				response->begin = 0;
+				response->total = response->chunked ? -1 : response->length;
+			}
+			if (response->chunked) {
+				response->length = -1;
+			}
+			return response;
+		}
+		proxy_response_free(response);
+		return NULL;
+	}
+	return NULL;
+}
+
+static gssize proxy_response_read(AvMediaPlayerProxyResponse* response, void* buffer, gsize size) {
+	// returns 0 at the end of the body, -1 on errors
+	if (response->chunked) {
+		if (response->chunk < 0) {
+			return 0;
+		} else if (response->chunk == 0) {
+			gchar* line = g_data_input_stream_read_line(response->in, NULL, response->cancellable, NULL);
+			if (!line) {
+				return -1;
+			}
+			response->chunk = g_ascii_strtoll(line, NULL, 16);
+			g_free(line);
+			if (response->chunk <= 0) {
+				// skip the trailers, so the connection can be reused
+				while ((line = g_data_input_stream_read_line(response->in, NULL, response->cancellable, NULL)) && line[0]) {
+					g_free(line);
+				}
+				response->reusable = response->reusable && line;
+				g_free(line);
+				response->chunk = -1;
+				return 0;
+			}
+		}
+		size = MIN(size, (gsize)response->chunk);
+	} else if (response->length == 0) {
+		return 0;
+	} else if (response->length > 0) {
+		size = MIN(size, (gsize)response->length);
+	}
+	gssize n = g_input_stream_read(G_INPUT_STREAM(response->in), buffer, size, response->cancellable, NULL);
+	if (n > 0 && response->chunked) {
+		response->chunk -= n;
+		if (response->chunk == 0) {
+			gchar* line = g_data_input_stream_read_line(response->in, NULL, response->cancellable, NULL);
+			if (!line) {
+				return -1;
+			}
+			g_free(line);
+		}
+	} else if (n > 0 && response->length > 0) {
+		response->length -= n;
+	} else if (n == 0 && (response->chunked || response->length > 0)) {
+		return -1; // truncated
+	}
+	return n;
+}
+
+/* cache objects, all functions here are called with the mutex held */
+static gchar* proxy_object_path(AvMediaPlayerProxyObject* obj, const gchar* extension) {
+	g_autofree gchar* name = g_strconcat(obj->name, extension, NULL);
+	return g_build_filename(proxy.dir, name, NULL);
+}
+
+static AvMediaPlayerProxyObject* proxy_object_new(const gchar* url) {
+	AvMediaPlayerProxyObject* obj = g_new0(AvMediaPlayerProxyObject, 1);
+	obj->url = g_strdup(url);
+	obj->name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, url, -1);
+	obj->ranges = g_array_new(FALSE, FALSE, sizeof(int64_t));
+	obj->fetches = g_ptr_array_new();
+	obj->size = -1;
+	obj->lastUsed = g_get_real_time();
+	return obj;
+}
+
+static void proxy_object_free(gpointer data) {
+	AvMediaPlayerProxyObject* obj = data;
+	g_free(obj->url);
+	g_free(obj->name);
+	g_free(obj->contentType);
+	g_free(obj->etag);
+	g_free(obj->lastModified);
+	g_array_free(obj->ranges, TRUE);
+	g_ptr_array_free(obj->fetches, TRUE);
+	g_free(obj);
+}
+
+static void proxy_object_save(AvMediaPlayerProxyObject* obj) {
+	g_autoptr(GKeyFile) meta = g_key_file_new();
+	g_key_file_set_string(meta, "object", "url", obj->url);
+	g_key_file_set_int64(meta, "object", "size", obj->size);
+	g_key_file_set_int64(meta, "object", "used", obj->lastUsed);
+	if (obj->contentType) {
+		g_key_file_set_string(meta, "object", "type", obj->contentType);
+	}
+	if (obj->etag) {
+		g_key_file_set_string(meta, "object", "etag", obj->etag);
+	}
+	if (obj->lastModified) {
+		g_key_file_set_string(meta, "object", "modified", obj->lastModified);
+	}
+	g_autoptr(GString) ranges = g_string_new(NULL);
+	for (guint i = 0; i < obj->ranges->len; i++) {
+		g_string_append_printf(ranges, i ? ";%" G_GINT64_FORMAT : "%" G_GINT64_FORMAT, g_array_index(obj->ranges, int64_t, i));
+	}
+	g_key_file_set_string(meta, "object", "ranges", ranges->str);
+	g_autofree gchar* path = proxy_object_path(obj, ".meta");
+	g_key_file_save_to_file(meta, path, NULL);
+	obj->dirty = false;
+}
+
+static void proxy_object_add(AvMediaPlayerProxyObject* obj, AvMediaPlayerProxyFetch* fetch, int64_t begin, int64_t end) {
+	range_add(obj->ranges, begin, end);
+	int64_t cached = range_length(obj->ranges);
+	proxy.size += cached - obj->cached;
+	obj->cached = cached;
+	obj->dirty = true;
+	fetch->pos = end;
+	g_cond_broadcast(&proxy.cond);
+}
+
+static bool proxy_object_check(AvMediaPlayerProxyObject* obj, AvMediaPlayerProxyResponse* response) {
+	// drops the cached bytes if the object changed on the server
+	if ((response->total < 0 || response->total == obj->size) &&
+		(!response->etag || !obj->etag || g_str_equal(response->etag, obj->etag)) &&
+		(!response->lastModified || !obj->lastModified || g_str_equal(response->lastModified, obj->lastModified))) {
+		return true;
+	}
+	g_array_set_size(obj->ranges, 0);
+	proxy.size -= obj->cached;
+	obj->cached = 0;
+	obj->size = response->total;
+	proxy_set_header(&obj->etag, response->etag);
+	proxy_set_header(&obj->lastModified, response->lastModified);
+	obj->dirty = true;
+	return false;
+}
+
+static AvMediaPlayerProxyFetch* proxy_object_find_fetch(AvMediaPlayerProxyObject* obj, int64_t pos) {
+	for (guint i = 0; i < obj->fetches->len; i++) {
+		AvMediaPlayerProxyFetch* fetch = g_ptr_array_index(obj->fetches, i);
+		if (fetch->pos <= pos && pos < fetch->end && pos - fetch->pos <= PROXY_WAIT_WINDOW) {
+			return fetch;
+		}
+	}
+	return NULL;
+}
+
+static void proxy_evict(void) {
+	// removes the least recently used objects which are not being read
+	while (proxy.size > proxy.maxSize) {
+		AvMediaPlayerProxyObject* victim = NULL;
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, proxy.objects);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			AvMediaPlayerProxyObject* obj = value;
+			if (obj->readers == 0 && (!victim || obj->lastUsed < victim->lastUsed)) {
+				victim = obj;
+			}
+		}
+		if (!victim) {
+			break;
+		}
+		g_autofree gchar* data = proxy_object_path(victim, ".data");
+		g_autofree gchar* meta = proxy_object_path(victim, ".meta");
+		g_unlink(data);
+		g_unlink(meta);
+		proxy.size -= victim->cached;
+		g_hash_table_remove(proxy.objects, victim->url);
+	}
+}
+
+static void proxy_load(void) {
+	GDir* dir = g_dir_open(proxy.dir, 0, NULL);
+	if (!dir) {
+		return;
+	}
+	const gchar* name;
+	while ((name = g_dir_read_name(dir))) {
+		if (!g_str_has_suffix(name, ".meta")) {
+			continue;
+		}
+		g_autofree gchar* path = g_build_filename(proxy.dir, name, NULL);
+		g_autoptr(GKeyFile) meta = g_key_file_new();
+		g_autofree gchar* url = NULL;
+		g_autofree gchar* ranges = NULL;
+		AvMediaPlayerProxyObject* obj = NULL;
+		if (g_key_file_load_from_file(meta, path, G_KEY_FILE_NONE, NULL) &&
+			(url = g_key_file_get_string(meta, "object", "url", NULL)) &&
+			(ranges = g_key_file_get_string(meta, "object", "ranges", NULL))) {
+			obj = proxy_object_new(url);
+			obj->size = g_key_file_get_int64(meta, "object", "size", NULL);
+			obj->lastUsed = g_key_file_get_int64(meta, "object", "used", NULL);
+			obj->contentType = g_key_file_get_string(meta, "object", "type", NULL);
+			obj->etag = g_key_file_get_string(meta, "object", "etag", NULL);
+			obj->lastModified = g_key_file_get_string(meta, "object", "modified", NULL);
+			gchar** parts = g_strsplit(ranges, ";", -1);
+			for (guint i = 0; parts[i] && parts[i + 1]; i += 2) {
+				range_add(obj->ranges, g_ascii_strtoll(parts[i], NULL, 10), g_ascii_strtoll(parts[i + 1], NULL, 10));
+			}
+			g_strfreev(parts);
+			obj->cached = range_length(obj->ranges);
+			g_autofree gchar* data = proxy_object_path(obj, ".data");
+			if (obj->size <= 0 || !g_file_test(data, G_FILE_TEST_IS_REGULAR) || g_hash_table_contains(proxy.objects, obj->url)) {
+				g_unlink(data);
+				proxy_object_free(obj);
+				obj = NULL;
+			}
+		}
+		if (obj) {
+			g_hash_table_insert(proxy.objects, obj->url, obj);
+			proxy.size += obj->cached;
+		} else {
+			g_unlink(path);
+		}
+	}
+	g_dir_close(dir);
+}
+
+/* serving */
+static void proxy_send_status(GOutputStream* out, int status, const gchar* reason) {
+	g_autofree gchar* str = g_strdup_printf("HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status, reason);
+	g_output_stream_write_all(out, str, strlen(str), NULL, NULL, NULL);
+}
+
+static bool proxy_is_playlist(const gchar* url, const gchar* contentType) {
+	const gchar* authority = strstr(url, "://") + 3;
+	const gchar* path = authority + strcspn(authority, "/?#");
+	gsize length = strcspn(path, "?#");
+	return (contentType && g_strrstr(contentType, "mpegurl")) || (length > 5 && !g_ascii_strncasecmp(path + length - 5, ".m3u8", 5));
+}
+
+static gchar* proxy_read_text(AvMediaPlayerProxyResponse* upstream) {
+	GByteArray* body = g_byte_array_new();
+	guchar buffer[4096];
+	gssize n;
+	while (body->len < PROXY_MAX_PLAYLIST && (n = proxy_response_read(upstream, buffer, sizeof(buffer))) > 0) {
+		g_byte_array_append(body, buffer, n);
+	}
+	g_byte_array_append(body, (const guint8*)"", 1);
+	return (gchar*)g_byte_array_free(body, FALSE);
+}
+
+static void proxy_serve_playlist(GOutputStream* out, AvMediaPlayerProxyResponse* upstream) {
+	// playlists are rewritten but never cached, as live playlists change all the time
+	g_autofree gchar* body = proxy_read_text(upstream);
+	g_autoptr(GString) playlist = g_string_new(NULL);
+	gchar** lines = g_strsplit(body, "\n", -1);
+	for (guint i = 0; lines[i]; i++) {
+		gchar* line = g_strstrip(lines[i]);
+		if (line[0] == '#') {
+			gchar* uri = strstr(line, "URI=\"");
+			gchar* end = uri ? strchr(uri + 5, '"') : NULL;
+			if (end) {
+				// keys are only made absolute, they should never be stored on disk
+				bool key = g_str_has_prefix(line, "#EXT-X-KEY") || g_str_has_prefix(line, "#EXT-X-SESSION-KEY");
+				g_autofree gchar* ref = g_strndup(uri + 5, end - uri - 5);
+				g_autofree gchar* resolved = proxy_resolve(upstream->url, ref);
+				g_autofree gchar* proxied = !key && proxy_is_http(resolved) ? proxy_url(resolved) : NULL;
+				g_string_append_len(playlist, line, uri + 5 - line);
+				g_string_append(playlist, proxied ? proxied : resolved);
+				g_string_append(playlist, end);
+			} else {
+				g_string_append(playlist, line);
+			}
+		} else if (line[0]) {
+			g_autofree gchar* resolved = proxy_resolve(upstream->url, line);
+			g_autofree gchar* proxied = proxy_is_http(resolved) ? proxy_url(resolved) : NULL;
+			g_string_append(playlist, proxied ? proxied : resolved);
+		}
+		g_string_append_c(playlist, '\n');
+	}
+	g_strfreev(lines);
+	g_autofree gchar* headers = g_strdup_printf("HTTP/1.1 200 OK\r\nContent-Type: application/vnd.apple.mpegurl\r\nContent-Length: %" G_GSIZE_FORMAT "\r\nConnection: close\r\n\r\n", playlist->len);
+	if (g_output_stream_write_all(out, headers, strlen(headers), NULL, NULL, NULL)) {
+		g_output_stream_write_all(out, playlist->str, playlist->len, NULL, NULL, NULL);
+	}
+}
+
+static void proxy_serve_through(GOutputStream* out, AvMediaPlayerProxyResponse* upstream) {
+	// objects of unknown size or larger than the whole cache are not stored
+	g_autoptr(GString) headers = g_string_new(NULL);
+	g_string_append_printf(headers, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nConnection: close\r\n", upstream->status, upstream->status == 206 ? "Partial Content" : "OK", upstream->contentType ? upstream->contentType : "application/octet-stream");
+	if (upstream->length >= 0) {
+		g_string_append_printf(headers, "Content-Length: %" G_GINT64_FORMAT "\r\n", upstream->length);
+		if (upstream->status == 206) {
+			g_string_append_printf(headers, "Content-Range: bytes %" G_GINT64_FORMAT "-%" G_GINT64_FORMAT "/", upstream->begin, upstream->begin + upstream->length - 1);
+			if (upstream->total >= 0) {
+				g_string_append_printf(headers, "%" G_GINT64_FORMAT "\r\n", upstream->total);
+			} else {
+				g_string_append(headers, "*\r\n");
+			}
+		}
+	}
+	g_string_append(headers, "\r\n");
+	guchar* buffer = g_malloc(PROXY_CHUNK);
+	bool ok = g_output_stream_write_all(out, headers->str, headers->len, NULL, NULL, NULL);
+	gssize n;
+	while (ok && (n = proxy_response_read(upstream, buffer, PROXY_CHUNK)) > 0) {
+		ok = g_output_stream_write_all(out, buffer, n, NULL, NULL, NULL);
+		g_mutex_lock(&proxy.mutex);
+		proxy.missBytes += n;
+		g_mutex_unlock(&proxy.mutex);
+	}
+	g_free(buffer);
+}
+
+static AvMediaPlayerProxyObject* proxy_object_acquire(const gchar* url, AvMediaPlayerProxyResponse* upstream) {
+	// returns the object of url with a reader added, it's created from upstream if it's not cached yet
+	g_mutex_lock(&proxy.mutex);
+	AvMediaPlayerProxyObject* obj = g_hash_table_lookup(proxy.objects, url);
+	if (!obj && upstream) {
+		obj = proxy_object_new(url);
+		obj->size = upstream->total;
+		obj->contentType = g_strdup(upstream->contentType);
+		obj->etag = g_strdup(upstream->etag);
+		obj->lastModified = g_strdup(upstream->lastModified);
+		g_hash_table_insert(proxy.objects, obj->url, obj);
+	}
+	if (obj) {
+		obj->readers++;
+		obj->lastUsed = g_get_real_time();
+	}
+	g_mutex_unlock(&proxy.mutex);
+	return obj;
+}
+
+static void proxy_object_release(AvMediaPlayerProxyObject* obj) {
+	g_mutex_lock(&proxy.mutex);
+	obj->readers--;
+	obj->lastUsed = g_get_real_time();
+	if (obj->readers == 0 && obj->dirty) {
+		proxy_object_save(obj);
+	}
+	proxy_evict();
+	g_mutex_unlock(&proxy.mutex);
+}
+
+static void proxy_serve_object(GOutputStream* out, AvMediaPlayerProxyObject* obj, AvMediaPlayerProxyResponse* upstream, int64_t begin, int64_t end, GCancellable* cancellable) {
+	// sends [begin, end) of obj, cached bytes are read from disk and missing bytes are downloaded, stored and sent.
+	// nothing is sent if out is NULL, which is used to prefetch. upstream is an optional response which is already open,
+	// it is freed here
+	g_autofree gchar* path = NULL;
+	g_mutex_lock(&proxy.mutex);
+	path = proxy_object_path(obj, ".data");
+	int64_t size = obj->size;
+	g_mutex_unlock(&proxy.mutex);
+	int fd = g_open(path, O_RDWR | O_CREAT, 0644);
+	guchar* buffer = g_malloc(PROXY_CHUNK);
+	int64_t pos = begin;
+	int64_t upstreamPos = upstream ? upstream->begin : -1;
+	gint64 deadline = 0;
+	bool ok = fd >= 0;
+	while (ok && pos < end) {
+		int64_t limit;
+		g_mutex_lock(&proxy.mutex);
+		if (range_lookup(obj->ranges, pos, &limit) && !out) {
+			g_mutex_unlock(&proxy.mutex);
+			pos = MIN(limit, end);
+			continue;
+		} else if (range_lookup(obj->ranges, pos, &limit)) {
+			g_mutex_unlock(&proxy.mutex);
+			gssize n = pread(fd, buffer, MIN(PROXY_CHUNK, MIN(limit, end) - pos), pos);
+			ok = n > 0 && g_output_stream_write_all(out, buffer, n, NULL, NULL, NULL);
+			if (ok) {
+				pos += n;
+				deadline = 0;
+				g_mutex_lock(&proxy.mutex);
+				proxy.hitBytes += n;
+				g_mutex_unlock(&proxy.mutex);
+			}
+			continue;
+		} else if (proxy_object_find_fetch(obj, pos)) {
+			if (deadline == 0) {
+				deadline = g_get_monotonic_time() + PROXY_WAIT_TIMEOUT;
+			}
+			if (g_cond_wait_until(&proxy.cond, &proxy.mutex, deadline) || g_get_monotonic_time() < deadline) {
+				g_mutex_unlock(&proxy.mutex);
+				continue;
+			}
+			// the running download stalled, fetch the bytes ourselves
+		}
+		if (limit < 0 || limit > size) {
+			limit = size;
+		}
+		AvMediaPlayerProxyFetch fetch = { pos, limit };
+		g_ptr_array_add(obj->fetches, &fetch);
+		g_mutex_unlock(&proxy.mutex);
+		if (upstream && (upstreamPos > pos || (pos - upstreamPos > PROXY_WAIT_WINDOW && upstream->status == 206))) {
+			proxy_response_free(upstream);
+			upstream = NULL;
+		}
+		if (!upstream) {
+			upstream = proxy_request(obj->url, pos, limit, cancellable);
+			upstreamPos = upstream ? upstream->begin : -1;
+			if (upstream) {
+				g_mutex_lock(&proxy.mutex);
+				ok = proxy_object_check(obj, upstream);
+				g_mutex_unlock(&proxy.mutex);
+			}
+		}
+		ok = ok && upstream && upstreamPos <= pos;
+		while (ok && upstreamPos < limit && pos < end) {
+			// bytes before pos are stored but not sent, this happens if the server doesn't support ranges
+			gssize n = proxy_response_read(upstream, buffer, MIN(PROXY_CHUNK, limit - upstreamPos));
+			ok = n > 0 && pwrite(fd, buffer, n, upstreamPos) == n;
+			if (ok) {
+				g_mutex_lock(&proxy.mutex);
+				proxy_object_add(obj, &fetch, upstreamPos, upstreamPos + n);
+				proxy.missBytes += n;
+				g_mutex_unlock(&proxy.mutex);
+				if (upstreamPos + n > pos) {
+					int64_t skip = pos - upstreamPos;
+					int64_t length = MIN(upstreamPos + n, end) - pos;
+					ok = !out || g_output_stream_write_all(out, buffer + skip, length, NULL, NULL, NULL);
+					pos += length;
+				}
+				upstreamPos += n;
+			}
+		}
+		g_mutex_lock(&proxy.mutex);
+		g_ptr_array_remove_fast(obj->fetches, &fetch);
+		g_cond_broadcast(&proxy.cond);
+		g_mutex_unlock(&proxy.mutex);
+		deadline = 0;
+	}
+	if (upstream) {
+		proxy_response_free(upstream);
+	}
+	g_free(buffer);
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+static void proxy_serve(GOutputStream* out, const gchar* url, bool ranged, int64_t begin, int64_t end) {
+	g_mutex_lock(&proxy.mutex);
+	proxy.requests++;
+	int64_t maxSize = proxy.maxSize;
+	g_mutex_unlock(&proxy.mutex);
+	AvMediaPlayerProxyObject* obj = proxy_object_acquire(url, NULL);
+	AvMediaPlayerProxyResponse* upstream = NULL;
+	if (!obj) {
+		upstream = proxy_request(url, begin, end, NULL);
+		if (!upstream) {
+			proxy_send_status(out, 502, "Bad Gateway");
+			return;
+		} else if (proxy_is_playlist(upstream->url, upstream->contentType)) {
+			proxy_serve_playlist(out, upstream);
+			proxy_response_free(upstream);
+			return;
+		} else if (upstream->total <= 0 || upstream->total > maxSize) {
+			proxy_serve_through(out, upstream);
+			proxy_response_free(upstream);
+			return;
+		}
+		obj = proxy_object_acquire(url, upstream);
+	}
+	g_mutex_lock(&proxy.mutex);
+	int64_t size = obj->size;
+	g_autofree gchar* contentType = g_strdup(obj->contentType ? obj->contentType : "application/octet-stream");
+	g_mutex_unlock(&proxy.mutex);
+	if (end < 0 || end > size) {
+		end = size;
+	}
+	if (begin >= size) {
+		g_autofree gchar* headers = g_strdup_printf("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%" G_GINT64_FORMAT "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", size);
+		g_output_stream_write_all(out, headers, strlen(headers), NULL, NULL, NULL);
+		if (upstream) {
+			proxy_response_free(upstream);
+		}
+	} else {
+		g_autoptr(GString) headers = g_string_new(NULL);
+		g_string_append_printf(headers, "HTTP/1.1 %s\r\nContent-Type: %s\r\nAccept-Ranges: bytes\r\nContent-Length: %" G_GINT64_FORMAT "\r\nConnection: close\r\n", ranged ? "206 Partial Content" : "200 OK", contentType, end - begin);
+		if (ranged) {
+			g_string_append_printf(headers, "Content-Range: bytes %" G_GINT64_FORMAT "-%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "\r\n", begin, end - 1, size);
+		}
+		g_string_append(headers, "\r\n");
+		if (g_output_stream_write_all(out, headers->str, headers->len, NULL, NULL, NULL)) {
+			proxy_serve_object(out, obj, upstream, begin, end, NULL);
+		} else if (upstream) {
+			proxy_response_free(upstream);
+		}
+	}
+	proxy_object_release(obj);
+}
+
+static gboolean proxy_run(GSocketService* service, GSocketConnection* connection, GObject* source, gpointer user_data) {
+	// runs in a worker thread for each connection, only one request is served per connection
+	GOutputStream* out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	g_autoptr(GDataInputStream) in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+	g_data_input_stream_set_newline_type(in, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+	g_autofree gchar* line = g_data_input_stream_read_line(in, NULL, NULL, NULL);
+	int64_t begin = 0;
+	int64_t end = -1;
+	bool ranged = false;
+	gchar* header;
+	while ((header = g_data_input_stream_read_line(in, NULL, NULL, NULL)) && header[0]) {
+		gchar* value = !g_ascii_strncasecmp(header, "Range:", 6) ? strstr(header, "bytes=") : NULL;
+		if (value && g_ascii_isdigit(value[6])) {
+			gchar* next;
+			ranged = true;
+			begin = g_ascii_strtoll(value + 6, &next, 10);
+			if (next[0] == '-' && g_ascii_isdigit(next[1])) {
+				end = g_ascii_strtoll(next + 1, NULL, 10) + 1;
+			}
+		}
+		g_free(header);
+	}
+	g_free(header);
+	gchar** request = line ? g_strsplit(line, " ", 3) : NULL;
+	g_autofree gchar* url = NULL;
+	// any local process can connect, so only urls made by proxy_url are served
+	const gsize length = strlen(proxy.token);
+	if (request && g_strv_length(request) == 3 && g_str_equal(request[0], "GET") && request[1][0] == '/' &&
+		strncmp(request[1] + 1, proxy.token, length) == 0 && request[1][length + 1] == '/') {
+		gchar* segment = request[1] + length + 2;
+		url = g_uri_unescape_segment(segment, segment + strcspn(segment, "/?"), NULL);
+	}
+	g_strfreev(request);
+	if (url && proxy_is_http(url)) {
+		proxy_serve(out, url, ranged, begin, end);
+	} else {
+		proxy_send_status(out, 400, "Bad Request");
+	}
+	g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+	return TRUE;
+}
+
+static gchar* proxy_new_token(void) {
+	// 128 bits from the kernel, other processes can't guess them
+	guint8 bytes[16];
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || read(fd, bytes, sizeof(bytes)) != sizeof(bytes)) {
+		for (gsize i = 0; i < sizeof(bytes); i++) {
+			bytes[i] = (guint8)g_random_int();
+		}
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	GString* token = g_string_sized_new(sizeof(bytes) * 2);
+	for (gsize i = 0; i < sizeof(bytes); i++) {
+		g_string_append_printf(token, "%02x", bytes[i]);
+	}
+	return g_string_free(token, FALSE);
+}
+
+static gboolean proxy_start(void) {
+	// called with the mutex held
+	if (!proxy.token) {
+		proxy.token = proxy_new_token();
+	}
+	proxy.dir = g_build_filename(g_get_user_cache_dir(), "av_media_player", "http", NULL);
+	g_mkdir_with_parents(proxy.dir, 0755);
+	proxy.objects = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, proxy_object_free);
+	proxy.pool = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	proxy_load();
+	proxy.client = g_socket_client_new();
+	g_socket_client_set_timeout(proxy.client, 15);
+	proxy.tlsClient = g_socket_client_new();
+	g_socket_client_set_timeout(proxy.tlsClient, 15);
+	g_socket_client_set_tls(proxy.tlsClient, TRUE);
+	proxy.service = g_threaded_socket_service_new(32);
+	g_autoptr(GInetAddress) loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+	g_autoptr(GSocketAddress) address = g_inet_socket_address_new(loopback, 0);
+	g_autoptr(GSocketAddress) effective = NULL;
+	if (!g_socket_listener_add_address(G_SOCKET_LISTENER(proxy.service), address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, &effective, NULL)) {
+		g_clear_object(&proxy.service);
+		return FALSE;
+	}
+	proxy.port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective));
+	g_signal_connect(proxy.service, "run", G_CALLBACK(proxy_run), NULL);
+	g_socket_service_start(proxy.service);
+	return TRUE;
+}
+
+/* warm up */
+static int64_t proxy_warm_up_reserve(AvMediaPlayerProxyWarmUp* job, int64_t bytes) {
+	g_mutex_lock(&proxy.mutex);
+	bytes = MIN(bytes, job->budget);
+	job->budget -= bytes;
+	g_mutex_unlock(&proxy.mutex);
+	return bytes;
+}
+
+static bool proxy_warm_up_cached(const gchar* url, int64_t bytes) {
+	// whether the first bytes of url are cached already, bytes is -1 for the whole object
+	int64_t limit;
+	g_mutex_lock(&proxy.mutex);
+	AvMediaPlayerProxyObject* obj = g_hash_table_lookup(proxy.objects, url);
+	bool cached = obj && range_lookup(obj->ranges, 0, &limit) && limit >= (bytes < 0 ? obj->size : MIN(bytes, obj->size));
+	g_mutex_unlock(&proxy.mutex);
+	return cached;
+}
+
+static void proxy_warm_up_connect(AvMediaPlayerProxyWarmUp* job, const gchar* url) {
+	g_autofree gchar* key = proxy_key(url);
+	GSocketConnection* connection = proxy_pool_take(key);
+	if (!connection) {
+		connection = proxy_connect(url, job->cancellable);
+	}
+	if (connection) {
+		proxy_pool_put(key, connection);
+	}
+}
+
+static void proxy_warm_up_url(AvMediaPlayerProxyWarmUp* job, const gchar* url, int64_t bytes, bool nested);
+
+static void proxy_warm_up_playlist(AvMediaPlayerProxyWarmUp* job, const gchar* base, const gchar* body, bool nested) {
+	// follows the variant with the highest bandwidth as mpv picks it by default, then fetches the first segments
+	gchar** lines = g_strsplit(body, "\n", -1);
+	GPtrArray* segments = g_ptr_array_new_with_free_func(g_free);
+	g_autofree gchar* variant = NULL;
+	int64_t bandwidth = -1;
+	int64_t streamBandwidth = -1; // bandwidth of the variant on the next uri line, -1 if it's not a variant
+	int count = 0;
+	for (guint i = 0; lines[i]; i++) {
+		gchar* line = g_strstrip(lines[i]);
+		if (g_str_has_prefix(line, "#EXT-X-STREAM-INF")) {
+			gchar* value = strstr(line, "BANDWIDTH=");
+			streamBandwidth = value ? g_ascii_strtoll(value + 10, NULL, 10) : 0;
+		} else if (g_str_has_prefix(line, "#EXT-X-MAP")) {
+			gchar* uri = strstr(line, "URI=\"");
+			gchar* end = uri ? strchr(uri + 5, '"') : NULL;
+			if (end) {
+				g_autofree gchar* ref = g_strndup(uri + 5, end - uri - 5);
+				g_ptr_array_add(segments, proxy_resolve(base, ref));
+			}
+		} else if (line[0] && line[0] != '#') {
+			if (streamBandwidth >= 0) {
+				if (streamBandwidth > bandwidth) {
+					bandwidth = streamBandwidth;
+					g_free(variant);
+					variant = proxy_resolve(base, line);
+				}
+				streamBandwidth = -1;
+			} else if (count < job->prefetchSegments) {
+				g_ptr_array_add(segments, proxy_resolve(base, line));
+				count++;
+			}
+		}
+	}
+	g_strfreev(lines);
+	if (variant && !nested) {
+		proxy_warm_up_url(job, variant, 0, true);
+	} else {
+		for (guint i = 0; i < segments->len; i++) {
+			proxy_warm_up_url(job, g_ptr_array_index(segments, i), -1, true);
+		}
+	}
+	g_ptr_array_free(segments, TRUE);
+}
+
+static void proxy_warm_up_url(AvMediaPlayerProxyWarmUp* job, const gchar* url, int64_t bytes, bool nested) {
+	// prefetches the first bytes of a progressive media, or the whole object if bytes is -1 which is used for segments
+	bool playlist = proxy_is_playlist(url, NULL);
+	if (g_cancellable_is_cancelled(job->cancellable) || !proxy_is_http(url)) {
+		return;
+	} else if ((playlist ? job->prefetchSegments : bytes) == 0 || proxy_warm_up_cached(url, bytes)) {
+		proxy_warm_up_connect(job, url);
+		return;
+	}
+	int64_t reserved = playlist || bytes < 0 ? 0 : proxy_warm_up_reserve(job, bytes);
+	if (!playlist && bytes > 0 && reserved == 0) {
+		proxy_warm_up_connect(job, url);
+		return;
+	}
+	AvMediaPlayerProxyResponse* upstream = proxy_request(url, 0, reserved > 0 ? reserved : -1, job->cancellable);
+	if (upstream && upstream->status == 206 && proxy_is_playlist(upstream->url, upstream->contentType)) {
+		// a playlist without the extension, fetch it again as a whole
+		proxy_response_free(upstream);
+		upstream = proxy_request(url, 0, -1, job->cancellable);
+	}
+	g_mutex_lock(&proxy.mutex);
+	int64_t maxSize = proxy.maxSize;
+	g_mutex_unlock(&proxy.mutex);
+	if (!upstream) {
+		return;
+	} else if (proxy_is_playlist(upstream->url, upstream->contentType)) {
+		g_autofree gchar* base = g_strdup(upstream->url);
+		g_autofree gchar* body = proxy_read_text(upstream);
+		proxy_response_free(upstream);
+		proxy_warm_up_playlist(job, base, body, nested);
+	} else if (upstream->total > 0 && upstream->total <= maxSize) {
+		int64_t end = bytes < 0 ? proxy_warm_up_reserve(job, upstream->total) : MIN(reserved, upstream->total);
+		AvMediaPlayerProxyObject* obj = proxy_object_acquire(url, upstream);
+		proxy_serve_object(NULL, obj, upstream, 0, end, job->cancellable);
+		proxy_object_release(obj);
+	} else {
+		proxy_response_free(upstream);
+	}
+}
+
+static void proxy_warm_up_run(gpointer data, gpointer user_data) {
+	AvMediaPlayerProxyWarmUp* job = user_data;
+	proxy_warm_up_url(job, data, job->prefetchBytes, false);
+}
+
+static gpointer proxy_warm_up_thread(gpointer data) {
+	// waits for all urls, so the main thread is never blocked
+	AvMediaPlayerProxyWarmUp* job = data;
+	GThreadPool* pool = g_thread_pool_new(proxy_warm_up_run, job, job->concurrency, FALSE, NULL);
+	for (guint i = 0; job->urls[i]; i++) {
+		g_thread_pool_push(pool, job->urls[i], NULL);
+	}
+	g_thread_pool_free(pool, FALSE, TRUE);
+	g_idle_add(job->callback, job->data);
+	g_strfreev(job->urls);
+	g_object_unref(job->cancellable);
+	g_free(job);
+	return NULL;
+}
+
+gboolean av_media_player_proxy_warm_up(const gchar* const* urls, int64_t prefetchBytes, int prefetchSegments, int concurrency, int64_t maxBytes, GCancellable* cancellable, GSourceFunc callback, gpointer data) {
+	g_mutex_lock(&proxy.mutex);
+	bool enabled = proxy.enabled;
+	g_mutex_unlock(&proxy.mutex);
+	if (!enabled) {
+		return FALSE;
+	}
+	AvMediaPlayerProxyWarmUp* job = g_new0(AvMediaPlayerProxyWarmUp, 1);
+	job->urls = g_strdupv((gchar**)urls);
+	job->cancellable = g_object_ref(cancellable);
+	job->callback = callback;
+	job->data = data;
+	job->prefetchBytes = prefetchBytes;
+	job->prefetchSegments = prefetchSegments;
+	job->concurrency = MAX(concurrency, 1);
+	job->budget = maxBytes;
+	g_thread_unref(g_thread_new("av_media_player_warm_up", proxy_warm_up_thread, job));
+	return TRUE;
+}
+
+gboolean av_media_player_proxy_set_max_size(int64_t maxSize) {
+	gboolean result = TRUE;
+	g_mutex_lock(&proxy.mutex);
+	if (maxSize > 0 && !proxy.service) {
+		result = proxy_start();
+	}
+	if (result) {
+		proxy.enabled = maxSize > 0;
+		if (maxSize > 0) {
+			proxy.maxSize = maxSize;
+			proxy_evict();
+		}
+	}
+	g_mutex_unlock(&proxy.mutex);
+	return result;
+}
+
+gchar* av_media_player_proxy_rewrite(const gchar* url) {
+	gchar* result = NULL;
+	g_mutex_lock(&proxy.mutex);
+	if (proxy.enabled && proxy_is_http(url)) {
+		result = proxy_url(url);
+	}
+	g_mutex_unlock(&proxy.mutex);
+	return result;
+}
+
+gchar* av_media_player_proxy_validator(const gchar* url) {
+	gchar* result = NULL;
+	g_mutex_lock(&proxy.mutex);
+	AvMediaPlayerProxyObject* obj = proxy.objects ? g_hash_table_lookup(proxy.objects, url) : NULL;
+	if (obj) {
+		result = g_strdup(obj->etag ? obj->etag : obj->lastModified);
+	}
+	g_mutex_unlock(&proxy.mutex);
+	return result;
+}
+
+void av_media_player_proxy_get_stats(AvMediaPlayerProxyStats* stats) {
+	g_mutex_lock(&proxy.mutex);
+	stats->size = proxy.size;
+	stats->maxSize = proxy.enabled ? proxy.maxSize : 0;
+	stats->hitBytes = proxy.hitBytes;
+	stats->missBytes = proxy.missBytes;
+	stats->requests = proxy.requests;
+	stats->objects = proxy.objects ? g_hash_table_size(proxy.objects) : 0;
+	g_mutex_unlock(&proxy.mutex);
+}
@@ -0,0 +1,36 @@
+#ifndef AV_MEDIA_PLAYER_PROXY_H_
+#define AV_MEDIA_PLAYER_PROXY_H_
+
+#include <gio/gio.h>
+#include <stdint.h>
+
+// caching http proxy shared by all players, it serves on 127.0.0.1 and keeps byte ranges of
+// progressive media and hls segments in a size capped lru on disk. proxied urls carry a random
+// token of the process, so other local processes can't use it as a relay
+typedef struct {
+	int64_t size;      // bytes on disk
+	int64_t maxSize;
+	int64_t hitBytes;  // bytes served from disk
+	int64_t missBytes; // bytes downloaded
+	int64_t requests;
+	int64_t objects;
+} AvMediaPlayerProxyStats;
+
+// maxSize is in bytes, 0 stops rewriting new sources, the proxy is started on first use
+gboolean av_media_player_proxy_set_max_size(int64_t maxSize);
+
+// returns the proxied url of an http(s) url, or NULL if the proxy is disabled or the url is not supported
+gchar* av_media_player_proxy_rewrite(const gchar* url);
+
+// returns the validator (ETag or Last-Modified) of a cached url, or NULL if it's unknown
+gchar* av_media_player_proxy_validator(const gchar* url);
+
+void av_media_player_proxy_get_stats(AvMediaPlayerProxyStats* stats);
+
+// connects to the hosts of urls ahead of time and keeps the connections alive, and stores the first prefetchBytes bytes
+// of progressive media or the first prefetchSegments segments of hls streams in the cache. at most concurrency urls are
+// processed at once, and at most maxBytes are downloaded in total. callback is called in the main thread once all urls
+// are done or cancellable is cancelled. returns FALSE if the proxy is disabled
+gboolean av_media_player_proxy_warm_up(const gchar* const* urls, int64_t prefetchBytes, int prefetchSegments, int concurrency, int64_t maxBytes, GCancellable* cancellable, GSourceFunc callback, gpointer data);
+
+#endif
@@ -0,0 +1,440 @@
+#include "av_media_player_stream.h"
+#include <mpv/stream_cb.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+#include <openssl/evp.h>
+#endif
+
+typedef struct {
+	AvMediaPlayerStreamProvider provider;
+	void* user;
+	char* data; // memory sources have data instead of a provider
+	int64_t size;
+	GMappedFile* mapped; // pack sources point data into the mapping of their pack
+	const char* meta;    // media info of pack sources, encoded with the standard message codec
+	gsize metaLength;
+	int refs; // one for the registry, and one for each reader
+	int fd;   // encrypted sources read a file instead, -1 for others
+	int keyLength;
+	guint8 key[32];
+	guint8 iv[16]; // the initial counter block
+} AvMediaPlayerStreamSource;
+
+typedef struct {
+	AvMediaPlayerStreamSource* source;
+	int64_t pos;
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+	EVP_CIPHER_CTX* cipher;
+	int64_t cipherPos; // where the keystream of cipher continues, -1 if it's not initialized
+#endif
+} AvMediaPlayerStreamReader;
+
+static struct {
+	GMutex mutex;
+	GHashTable* sources; // url to source
+	int64_t memoryId; // also used for encrypted sources
+	GHashTable* packs; // path to a GPtrArray of the urls it provides
+} streams;
+
+static void stream_unref(AvMediaPlayerStreamSource* source) {
+	g_mutex_lock(&streams.mutex);
+	bool last = --source->refs == 0;
+	g_mutex_unlock(&streams.mutex);
+	if (last) {
+		if (source->mapped) {
+			g_mapped_file_unref(source->mapped);
+		} else if (source->data) {
+			g_free(source->data);
+		} else if (source->fd >= 0) {
+			close(source->fd);
+			memset(source->key, 0, sizeof(source->key));
+		} else if (source->provider.close) {
+			source->provider.close(source->user);
+		}
+		g_free(source);
+	}
+}
+
+static bool stream_add(gchar* url, AvMediaPlayerStreamSource* source) {
+	// takes url, fails if it's already taken
+	g_mutex_lock(&streams.mutex);
+	if (!streams.sources) {
+		streams.sources = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+	bool added = !g_hash_table_contains(streams.sources, url);
+	if (added) {
+		source->refs = 1;
+		g_hash_table_insert(streams.sources, url, source);
+	} else {
+		g_free(url);
+	}
+	g_mutex_unlock(&streams.mutex);
+	return added;
+}
+
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+static bool stream_cipher_seek(AvMediaPlayerStreamReader* reader, int64_t pos) {
+	// aes-ctr is random access, the counter block of pos is the initial one plus the block index as a 128 bit big endian integer.
+	// openssl picks the fastest implementation the cpu supports, like aes-ni or vaes
+	AvMediaPlayerStreamSource* source = reader->source;
+	guint8 counter[16];
+	memcpy(counter, source->iv, 16);
+	uint64_t carry = (uint64_t)pos / 16;
+	for (int i = 15; i >= 0 && carry; i--) {
+		carry += counter[i];
+		counter[i] = (guint8)carry;
+		carry >>= 8;
+	}
+	if (!reader->cipher) {
+		reader->cipher = EVP_CIPHER_CTX_new();
+	}
+	const EVP_CIPHER* type = source->keyLength == 32 ? EVP_aes_256_ctr() : source->keyLength == 24 ? EVP_aes_192_ctr() : EVP_aes_128_ctr();
+	if (!reader->cipher || EVP_DecryptInit_ex(reader->cipher, type, NULL, source->key, counter) != 1) {
+		return false;
+	}
+	// skip into the block
+	guint8 skip[16] = { 0 };
+	int n;
+	if (pos % 16 && EVP_DecryptUpdate(reader->cipher, skip, &n, skip, (int)(pos % 16)) != 1) {
+		return false;
+	}
+	reader->cipherPos = pos;
+	return true;
+}
+#endif
+
+static int64_t stream_read(void* cookie, char* buf, uint64_t nbytes) {
+	AvMediaPlayerStreamReader* reader = cookie;
+	AvMediaPlayerStreamSource* source = reader->source;
+	int64_t n;
+	if (source->fd >= 0) {
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+		n = pread(source->fd, buf, MIN(nbytes, (uint64_t)G_MAXINT), reader->pos);
+		if (n > 0) {
+			// ctr mode decrypts in place
+			int m;
+			if ((reader->cipherPos != reader->pos && !stream_cipher_seek(reader, reader->pos)) ||
+				EVP_DecryptUpdate(reader->cipher, (guint8*)buf, &m, (guint8*)buf, (int)n) != 1) {
+				return -1;
+			}
+			reader->cipherPos = reader->pos + n;
+		}
+#else
+		n = -1;
+#endif
+	} else if (source->data) {
+		n = MIN((int64_t)nbytes, MAX(source->size - reader->pos, 0));
+		memcpy(buf, source->data + reader->pos, n);
+	} else {
+		n = source->provider.read(source->user, reader->pos, buf, nbytes);
+	}
+	if (n > 0) {
+		reader->pos += n;
+	}
+	return n;
+}
+
+static int64_t stream_source_size(AvMediaPlayerStreamSource* source) {
+	return source->data || source->fd >= 0 ? source->size : source->provider.size(source->user);
+}
+
+static int64_t stream_seek(void* cookie, int64_t offset) {
+	AvMediaPlayerStreamReader* reader = cookie;
+	int64_t size = stream_source_size(reader->source);
+	if (offset < 0 || (size >= 0 && offset > size)) {
+		return MPV_ERROR_GENERIC;
+	}
+	reader->pos = offset;
+	return offset;
+}
+
+static int64_t stream_size(void* cookie) {
+	AvMediaPlayerStreamReader* reader = cookie;
+	int64_t size = stream_source_size(reader->source);
+	return size < 0 ? MPV_ERROR_UNSUPPORTED : size;
+}
+
+static void stream_close(void* cookie) {
+	AvMediaPlayerStreamReader* reader = cookie;
+	stream_unref(reader->source);
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+	if (reader->cipher) {
+		EVP_CIPHER_CTX_free(reader->cipher);
+	}
+#endif
+	g_free(reader);
+}
+
+static int stream_open(void* user_data, char* uri, mpv_stream_cb_info* info) {
+	g_mutex_lock(&streams.mutex);
+	AvMediaPlayerStreamSource* source = streams.sources ? g_hash_table_lookup(streams.sources, uri) : NULL;
+	if (source) {
+		source->refs++;
+	}
+	g_mutex_unlock(&streams.mutex);
+	if (!source) {
+		return MPV_ERROR_LOADING_FAILED;
+	}
+	AvMediaPlayerStreamReader* reader = g_new0(AvMediaPlayerStreamReader, 1);
+	reader->source = source;
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+	reader->cipherPos = -1;
+#endif
+	info->cookie = reader;
+	info->read_fn = stream_read;
+	info->seek_fn = stream_seek;
+	info->size_fn = stream_size;
+	info->close_fn = stream_close;
+	return 0;
+}
+
+void av_media_player_stream_attach(mpv_handle* mpv) {
+	mpv_stream_cb_add_ro(mpv, "avmem", NULL, stream_open);
+	mpv_stream_cb_add_ro(mpv, "avstream", NULL, stream_open);
+	mpv_stream_cb_add_ro(mpv, "avcrypt", NULL, stream_open);
+	mpv_stream_cb_add_ro(mpv, "pack", NULL, stream_open);
+}
+
+void* av_media_player_stream_alloc(int64_t size, gchar** url) {
+	char* data = size > 0 ? g_try_malloc(size) : NULL;
+	if (!data) {
+		return NULL;
+	}
+	AvMediaPlayerStreamSource* source = g_new0(AvMediaPlayerStreamSource, 1);
+	source->fd = -1;
+	source->data = data;
+	source->size = size;
+	g_mutex_lock(&streams.mutex);
+	int64_t id = ++streams.memoryId;
+	g_mutex_unlock(&streams.mutex);
+	*url = g_strdup_printf("avmem://%" G_GINT64_FORMAT, id);
+	stream_add(g_strdup(*url), source);
+	return data;
+}
+
+gchar* av_media_player_stream_add_encrypted(const gchar* path, const guint8* key, int keyLength, const guint8* iv) {
+#ifdef AV_MEDIA_PLAYER_CRYPTO
+	GStatBuf st;
+	if ((keyLength != 16 && keyLength != 24 && keyLength != 32) || g_stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+	int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+	AvMediaPlayerStreamSource* source = g_new0(AvMediaPlayerStreamSource, 1);
+	source->fd = fd;
+	source->size = st.st_size;
+	source->keyLength = keyLength;
+	memcpy(source->key, key, keyLength);
+	memcpy(source->iv, iv, 16);
+	g_mutex_lock(&streams.mutex);
+	int64_t id = ++streams.memoryId;
+	g_mutex_unlock(&streams.mutex);
+	gchar* url = g_strdup_printf("avcrypt://%" G_GINT64_FORMAT, id);
+	stream_add(g_strdup(url), source);
+	return url;
+#else
+	return NULL;
+#endif
+}
+
+void av_media_player_stream_release(const gchar* url) {
+	g_mutex_lock(&streams.mutex);
+	AvMediaPlayerStreamSource* source = NULL;
+	if (streams.sources) {
+		source = g_hash_table_lookup(streams.sources, url);
+		g_hash_table_remove(streams.sources, url);
+	}
+	g_mutex_unlock(&streams.mutex);
+	if (source) {
+		stream_unref(source);
+	}
+}
+
+/* packs, a header and an index followed by the concatenated media, all integers are little endian.
+ * header: "AVPK", u32 version, u32 count, u32 reserved
+ * entry: u64 offset, u64 size, u32 meta length, u16 name length, name, meta */
+#define PACK_HEADER 16
+#define PACK_ENTRY 22
+
+static uint64_t pack_read(const char* p, int bytes) {
+	uint64_t value = 0;
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = value << 8 | (guint8)p[i];
+	}
+	return value;
+}
+
+static void pack_write(GByteArray* out, uint64_t value, int bytes) {
+	guint8 p[8];
+	for (int i = 0; i < bytes; i++) {
+		p[i] = (guint8)(value >> (i * 8));
+	}
+	g_byte_array_append(out, p, bytes);
+}
+
+int av_media_player_stream_load_pack(const gchar* path) {
+	g_mutex_lock(&streams.mutex);
+	bool loaded = streams.packs && g_hash_table_contains(streams.packs, path);
+	g_mutex_unlock(&streams.mutex);
+	if (loaded) {
+		return 0;
+	}
+	GMappedFile* mapped = g_mapped_file_new(path, FALSE, NULL);
+	if (!mapped) {
+		return -1;
+	}
+	const char* data = g_mapped_file_get_contents(mapped);
+	gsize length = g_mapped_file_get_length(mapped);
+	if (length < PACK_HEADER || memcmp(data, "AVPK", 4) != 0 || pack_read(data + 4, 4) != 1) {
+		g_mapped_file_unref(mapped);
+		return -1;
+	}
+	uint32_t count = (uint32_t)pack_read(data + 8, 4);
+	GPtrArray* urls = g_ptr_array_new_with_free_func(g_free);
+	gsize p = PACK_HEADER;
+	for (uint32_t i = 0; i < count && p + PACK_ENTRY <= length; i++) {
+		uint64_t offset = pack_read(data + p, 8);
+		uint64_t size = pack_read(data + p + 8, 8);
+		uint32_t metaLength = (uint32_t)pack_read(data + p + 16, 4);
+		uint16_t nameLength = (uint16_t)pack_read(data + p + 20, 2);
+		const char* name = data + p + PACK_ENTRY;
+		p += PACK_ENTRY + nameLength + metaLength;
+		if (p > length || offset > length || size > length - offset) {
+			break;
+		}
+		AvMediaPlayerStreamSource* source = g_new0(AvMediaPlayerStreamSource, 1);
+		source->fd = -1;
+		source->data = (char*)data + offset;
+		source->size = size;
+		source->mapped = g_mapped_file_ref(mapped);
+		source->meta = metaLength ? name + nameLength : NULL;
+		source->metaLength = metaLength;
+		gchar* url = g_strdup_printf("pack://%.*s", nameLength, name);
+		if (stream_add(g_strdup(url), source)) {
+			g_ptr_array_add(urls, url);
+		} else {
+			// the name is provided by another pack
+			g_mapped_file_unref(mapped);
+			g_free(source);
+			g_free(url);
+		}
+	}
+	g_mapped_file_unref(mapped);
+	int added = urls->len;
+	g_mutex_lock(&streams.mutex);
+	if (!streams.packs) {
+		streams.packs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+	}
+	g_hash_table_insert(streams.packs, g_strdup(path), urls);
+	g_mutex_unlock(&streams.mutex);
+	return added;
+}
+
+void av_media_player_stream_unload_pack(const gchar* path) {
+	g_mutex_lock(&streams.mutex);
+	GPtrArray* urls = NULL;
+	if (streams.packs) {
+		g_hash_table_steal_extended(streams.packs, path, NULL, (gpointer*)&urls);
+	}
+	g_mutex_unlock(&streams.mutex);
+	if (urls) {
+		for (guint i = 0; i < urls->len; i++) {
+			av_media_player_stream_release(g_ptr_array_index(urls, i));
+		}
+		g_ptr_array_unref(urls);
+	}
+}
+
+GBytes* av_media_player_stream_get_meta(const gchar* url) {
+	GBytes* meta = NULL;
+	g_mutex_lock(&streams.mutex);
+	AvMediaPlayerStreamSource* source = streams.sources ? g_hash_table_lookup(streams.sources, url) : NULL;
+	if (source && source->meta) {
+		meta = g_bytes_new(source->meta, source->metaLength);
+	}
+	g_mutex_unlock(&streams.mutex);
+	return meta;
+}
+
+gboolean av_media_player_stream_write_pack(const gchar* output, const gchar* const* names, const gchar* const* paths, GBytes* const* metas) {
+	// the index is written first, so all offsets are known before the media is copied
+	guint count = g_strv_length((gchar**)names);
+	GByteArray* index = g_byte_array_new();
+	uint64_t* sizes = g_new0(uint64_t, count);
+	gsize indexSize = PACK_HEADER;
+	for (guint i = 0; i < count; i++) {
+		GStatBuf st;
+		if (g_stat(paths[i], &st) != 0 || !S_ISREG(st.st_mode) || strlen(names[i]) > G_MAXUINT16) {
+			g_byte_array_unref(index);
+			g_free(sizes);
+			return FALSE;
+		}
+		sizes[i] = st.st_size;
+		indexSize += PACK_ENTRY + strlen(names[i]) + (metas[i] ? g_bytes_get_size(metas[i]) : 0);
+	}
+	g_byte_array_append(index, (const guint8*)"AVPK", 4);
+	pack_write(index, 1, 4);
+	pack_write(index, count, 4);
+	pack_write(index, 0, 4);
+	uint64_t offset = indexSize;
+	for (guint i = 0; i < count; i++) {
+		gsize metaLength = 0;
+		const guint8* meta = metas[i] ? g_bytes_get_data(metas[i], &metaLength) : NULL;
+		size_t nameLength = strlen(names[i]);
+		pack_write(index, offset, 8);
+		pack_write(index, sizes[i], 8);
+		pack_write(index, metaLength, 4);
+		pack_write(index, nameLength, 2);
+		g_byte_array_append(index, (const guint8*)names[i], nameLength);
+		if (meta) {
+			g_byte_array_append(index, meta, metaLength);
+		}
+		offset += sizes[i];
+	}
+	g_free(sizes);
+	g_autofree gchar* tmp = g_strconcat(output, ".tmp", NULL);
+	g_autoptr(GFile) file = g_file_new_for_path(tmp);
+	GFileOutputStream* out = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL);
+	bool ok = out && g_output_stream_write_all(G_OUTPUT_STREAM(out), index->data, index->len, NULL, NULL, NULL);
+	g_byte_array_unref(index);
+	for (guint i = 0; ok && i < count; i++) {
+		g_autoptr(GFile) src = g_file_new_for_path(paths[i]);
+		GFileInputStream* in = g_file_read(src, NULL, NULL);
+		ok = in && g_output_stream_splice(G_OUTPUT_STREAM(out), G_INPUT_STREAM(in), G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE, NULL, NULL) >= 0;
+		if (in) {
+			g_object_unref(in);
+		}
+	}
+	if (out) {
+		ok = g_output_stream_close(G_OUTPUT_STREAM(out), NULL, NULL) && ok;
+		g_object_unref(out);
+	}
+	if (ok) {
+		ok = g_rename(tmp, output) == 0;
+	} else {
+		g_unlink(tmp);
+	}
+	return ok;
+}
+
+gboolean av_media_player_register_stream(const gchar* name, const AvMediaPlayerStreamProvider* provider, void* user) {
+	AvMediaPlayerStreamSource* source = g_new0(AvMediaPlayerStreamSource, 1);
+	source->fd = -1;
+	source->provider = *provider;
+	source->user = user;
+	if (!stream_add(g_strconcat("avstream://", name, NULL), source)) {
+		g_free(source);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void av_media_player_unregister_stream(const gchar* name) {
+	g_autofree gchar* url = g_strconcat("avstream://", name, NULL);
+	av_media_player_stream_release(url);
+}
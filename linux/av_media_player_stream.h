@@ -0,0 +1,34 @@
+#ifndef AV_MEDIA_PLAYER_STREAM_H_
+#define AV_MEDIA_PLAYER_STREAM_H_
+
+#include "include/av_media_player/av_media_player_plugin.h"
+#include <mpv/client.h>
+
+// custom sources read by mpv through stream callbacks. memory allocated by the plugin is opened as avmem://<id>,
+// encrypted files as avcrypt://<id>, media in packs as pack://<name> and providers registered by native code as avstream://<name>. a source stays readable by players that opened it
+// until they close it, even after it's released
+void av_media_player_stream_attach(mpv_handle* mpv);
+
+// allocates size bytes for a memory source and sets url, returns NULL on failure
+void* av_media_player_stream_alloc(int64_t size, gchar** url);
+
+// opens a file encrypted with aes-ctr, key is 16, 24 or 32 bytes and iv is the 16 bytes initial counter block.
+// returns the url (avcrypt://<id>), or NULL on failure or if the plugin is built without libcrypto
+gchar* av_media_player_stream_add_encrypted(const gchar* path, const guint8* key, int keyLength, const guint8* iv);
+
+// maps a pack and provides its media as pack://<name>. returns the number of media, or -1 if it's not a valid pack
+int av_media_player_stream_load_pack(const gchar* path);
+
+void av_media_player_stream_unload_pack(const gchar* path);
+
+// returns the media info stored in the pack for url, or NULL
+GBytes* av_media_player_stream_get_meta(const gchar* url);
+
+// writes a pack of the files in paths named by names, both NULL terminated. metas has the media info of each file,
+// encoded with the standard message codec, or NULL entries if it's unknown
+gboolean av_media_player_stream_write_pack(const gchar* output, const gchar* const* names, const gchar* const* paths, GBytes* const* metas);
+
+// releases a memory source, an encrypted source or a provider by url
+void av_media_player_stream_release(const gchar* url);
+
+#endif
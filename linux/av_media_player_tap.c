@@ -0,0 +1,304 @@
+#include "av_media_player_tap.h"
+#include <string.h>
+
+#define AV_MEDIA_PLAYER_TAP_READBACKS 3 // frames read back at once, a frame is skipped when all of them are busy
+
+typedef struct {
+	gint refs;      // one for the tap and one for each frame dart holds
+	uint8_t* slots;
+} AvMediaPlayerTapRing;
+
+typedef struct {
+	GLuint pbo;
+	GLsync fence; // NULL when the buffer is free
+	int64_t pts;
+	GLsizei width;
+	GLsizei height;
+} AvMediaPlayerTapReadback;
+
+struct _AvMediaPlayerTap {
+	int64_t id;
+	uint32_t format;
+	uint16_t maxSize;
+	int64_t interval; // microseconds between two frames
+	int64_t nextTime; // monotonic time of the next frame
+	int64_t lastPts;  // the same frame is rendered again when the player is paused
+	AvMediaPlayerTapDone done;
+	GLuint source;    // framebuffer to read the rendered frame
+	GLuint texture;   // scaled frame
+	GLuint fbo;
+	GLsizei width;
+	GLsizei height;
+	AvMediaPlayerTapReadback readbacks[AV_MEDIA_PLAYER_TAP_READBACKS];
+	int next;         // the readback to use next, which is also the oldest one in flight
+	AvMediaPlayerTapRing* ring; // outlives the tap while dart holds frames in it
+	gsize slotSize;
+	uint64_t sequence; // of the latest frame, only touched by the worker
+	gint refs;         // one for the player and one for each frame on the way
+	gint closed;
+};
+
+typedef struct {
+	AvMediaPlayerTap* tap;
+	uint8_t* pixels; // rgba rows from the top
+	int64_t pts;
+	GLsizei width;
+	GLsizei height;
+} AvMediaPlayerTapFrame;
+
+typedef struct {
+	AvMediaPlayerTap* tap;
+	const uint8_t* slot;
+	AvMediaPlayerFrame frame;
+	uint64_t sequence;
+} AvMediaPlayerTapResult;
+
+static struct {
+	GMutex mutex;
+	AvMediaPlayerFrameCallback callback;
+	void* user;
+	GThreadPool* pool; // converts frames in the order they were read, created on first use
+} taps;
+
+static void tap_ring_unref(AvMediaPlayerTapRing* ring) {
+	if (g_atomic_int_dec_and_test(&ring->refs)) {
+		g_free(ring->slots);
+		g_free(ring);
+	}
+}
+
+static void tap_unref(AvMediaPlayerTap* tap) {
+	if (g_atomic_int_dec_and_test(&tap->refs)) {
+		tap_ring_unref(tap->ring);
+		g_free(tap);
+	}
+}
+
+static void tap_rgba_to_nv12(const uint8_t* rgba, const uint32_t width, const uint32_t height, uint8_t* y, uint8_t* uv) {
+	// bt.601 limited range, width and height are even. the inner loops are branchless integer math
+	// over contiguous rows, so the compiler vectorizes them
+	for (uint32_t row = 0; row < height; row++) {
+		const uint8_t* s = rgba + (gsize)row * width * 4;
+		uint8_t* d = y + (gsize)row * width;
+		for (uint32_t x = 0; x < width; x++) {
+			d[x] = (uint8_t)(((66 * s[x * 4] + 129 * s[x * 4 + 1] + 25 * s[x * 4 + 2] + 128) >> 8) + 16);
+		}
+	}
+	for (uint32_t row = 0; row < height / 2; row++) {
+		const uint8_t* s0 = rgba + (gsize)row * 2 * width * 4;
+		const uint8_t* s1 = s0 + (gsize)width * 4;
+		uint8_t* d = uv + (gsize)row * width;
+		for (uint32_t x = 0; x < width / 2; x++) {
+			// sums of 2x2 blocks
+			const int r = s0[x * 8] + s0[x * 8 + 4] + s1[x * 8] + s1[x * 8 + 4];
+			const int g = s0[x * 8 + 1] + s0[x * 8 + 5] + s1[x * 8 + 1] + s1[x * 8 + 5];
+			const int b = s0[x * 8 + 2] + s0[x * 8 + 6] + s1[x * 8 + 2] + s1[x * 8 + 6];
+			d[x * 2] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+			d[x * 2 + 1] = (uint8_t)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+		}
+	}
+}
+
+static gboolean tap_done(void* data) {
+	AvMediaPlayerTapResult* result = data;
+	AvMediaPlayerTap* tap = result->tap;
+	if (!g_atomic_int_get(&tap->closed)) {
+		// dart gets its own reference of the ring, released by av_media_player_release_frame
+		g_atomic_int_inc(&tap->ring->refs);
+		if (!tap->done(tap->id, tap->ring, result->slot, &result->frame, result->sequence)) {
+			tap_ring_unref(tap->ring);
+		}
+	}
+	tap_unref(result->tap);
+	g_free(result);
+	return G_SOURCE_REMOVE;
+}
+
+static void tap_convert(gpointer data, gpointer user_data) {
+	AvMediaPlayerTapFrame* frame = data;
+	AvMediaPlayerTap* tap = frame->tap;
+	if (g_atomic_int_get(&tap->closed)) {
+		tap_unref(tap);
+	} else {
+		const uint64_t sequence = ++tap->sequence;
+		uint8_t* slot = tap->ring->slots + (sequence % AV_MEDIA_PLAYER_TAP_SLOTS) * tap->slotSize;
+		uint8_t* pixels = slot + AV_MEDIA_PLAYER_TAP_HEADER;
+		const gsize area = (gsize)frame->width * frame->height;
+		// readers skip a slot while its sequence is 0
+		__atomic_store_n((uint64_t*)slot, 0, __ATOMIC_RELEASE);
+		AvMediaPlayerFrame info = { frame->pts, (uint32_t)frame->width, (uint32_t)frame->height, tap->format, 0, pixels };
+		if (tap->format == 1) {
+			tap_rgba_to_nv12(frame->pixels, info.width, info.height, pixels, pixels + area);
+			info.size = (uint32_t)(area * 3 / 2);
+		} else {
+			memcpy(pixels, frame->pixels, area * 4);
+			info.size = (uint32_t)(area * 4);
+		}
+		memcpy(slot + 8, &info.pts, 8);
+		memcpy(slot + 16, &info.width, 4);
+		memcpy(slot + 20, &info.height, 4);
+		memcpy(slot + 24, &info.format, 4);
+		memcpy(slot + 28, &info.size, 4);
+		__atomic_store_n((uint64_t*)slot, sequence, __ATOMIC_RELEASE);
+		g_mutex_lock(&taps.mutex);
+		if (taps.callback) {
+			taps.callback(tap->id, &info, taps.user);
+		}
+		g_mutex_unlock(&taps.mutex);
+		// the reference of the frame moves to the result
+		AvMediaPlayerTapResult* result = g_new(AvMediaPlayerTapResult, 1);
+		result->tap = tap;
+		result->slot = slot;
+		result->frame = info;
+		result->sequence = sequence;
+		g_idle_add(tap_done, result);
+	}
+	g_free(frame->pixels);
+	g_free(frame);
+}
+
+AvMediaPlayerTap* av_media_player_tap_new(int64_t id, uint32_t format, uint16_t maxSize, double frameRate, AvMediaPlayerTapDone done) {
+	maxSize = MAX(maxSize, 2);
+	const gsize slotSize = (AV_MEDIA_PLAYER_TAP_HEADER + (gsize)maxSize * maxSize * 4 + 63) & ~(gsize)63;
+	// pages of the ring are only committed once frames are written into them
+	uint8_t* slots = g_try_malloc(slotSize * AV_MEDIA_PLAYER_TAP_SLOTS);
+	if (!slots) {
+		return NULL;
+	}
+	for (int i = 0; i < AV_MEDIA_PLAYER_TAP_SLOTS; i++) {
+		memset(slots + i * slotSize, 0, AV_MEDIA_PLAYER_TAP_HEADER);
+	}
+	AvMediaPlayerTapRing* ring = g_new(AvMediaPlayerTapRing, 1);
+	ring->refs = 1;
+	ring->slots = slots;
+	if (!taps.pool) {
+		taps.pool = g_thread_pool_new(tap_convert, NULL, 1, FALSE, NULL);
+	}
+	AvMediaPlayerTap* tap = g_new0(AvMediaPlayerTap, 1);
+	tap->id = id;
+	tap->format = format;
+	tap->maxSize = maxSize;
+	tap->interval = (int64_t)(G_USEC_PER_SEC / frameRate);
+	tap->lastPts = -1;
+	tap->done = done;
+	tap->ring = ring;
+	tap->slotSize = slotSize;
+	tap->refs = 1;
+	return tap;
+}
+
+gboolean av_media_player_tap_update(AvMediaPlayerTap* tap, GLuint texture, GLsizei width, GLsizei height, int64_t pts) {
+	// hand finished readbacks to the worker, fences signal in the order the readbacks were issued
+	for (int i = 0; i < AV_MEDIA_PLAYER_TAP_READBACKS; i++) {
+		AvMediaPlayerTapReadback* readback = &tap->readbacks[(tap->next + i) % AV_MEDIA_PLAYER_TAP_READBACKS];
+		if (!readback->fence) {
+			continue;
+		} else if (glClientWaitSync(readback->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			break;
+		}
+		const gsize size = (gsize)readback->width * readback->height * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+		const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+		if (data) {
+			AvMediaPlayerTapFrame* frame = g_new(AvMediaPlayerTapFrame, 1);
+			frame->tap = tap;
+			frame->pixels = g_malloc(size);
+			memcpy(frame->pixels, data, size);
+			frame->pts = readback->pts;
+			frame->width = readback->width;
+			frame->height = readback->height;
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			g_atomic_int_inc(&tap->refs);
+			g_thread_pool_push(taps.pool, frame, NULL);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteSync(readback->fence);
+		readback->fence = NULL;
+	}
+	const int64_t now = g_get_monotonic_time();
+	AvMediaPlayerTapReadback* readback = &tap->readbacks[tap->next];
+	if (pts == tap->lastPts || now < tap->nextTime || readback->fence) {
+		// not a new frame, not due yet, or all readbacks are busy
+		for (int i = 0; i < AV_MEDIA_PLAYER_TAP_READBACKS; i++) {
+			if (tap->readbacks[i].fence) {
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+	tap->lastPts = pts;
+	tap->nextTime = now - tap->nextTime > tap->interval ? now + tap->interval : tap->nextTime + tap->interval;
+	const double scale = MIN(1.0, (double)tap->maxSize / MAX(width, height));
+	const GLsizei w = MAX((GLsizei)(width * scale) & ~1, 2);
+	const GLsizei h = MAX((GLsizei)(height * scale) & ~1, 2);
+	if (tap->width != w || tap->height != h) {
+		if (tap->texture) {
+			glDeleteTextures(1, &tap->texture);
+			glDeleteFramebuffers(1, &tap->fbo);
+		} else {
+			glGenFramebuffers(1, &tap->source);
+		}
+		glGenTextures(1, &tap->texture);
+		glBindTexture(GL_TEXTURE_2D, tap->texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glGenFramebuffers(1, &tap->fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, tap->fbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tap->texture, 0);
+		tap->width = w;
+		tap->height = h;
+	}
+	// scale on the gpu, mpv renders without flipping so the read back rows already start at the top
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, tap->source);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, tap->fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, tap->fbo);
+	if (!readback->pbo) {
+		glGenBuffers(1, &readback->pbo);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)w * h * 4, NULL, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback->pts = pts;
+	readback->width = w;
+	readback->height = h;
+	tap->next = (tap->next + 1) % AV_MEDIA_PLAYER_TAP_READBACKS;
+	return TRUE;
+}
+
+void av_media_player_tap_close(AvMediaPlayerTap* tap) {
+	g_atomic_int_set(&tap->closed, 1);
+}
+
+void av_media_player_tap_free(AvMediaPlayerTap* tap) {
+	g_atomic_int_set(&tap->closed, 1);
+	for (int i = 0; i < AV_MEDIA_PLAYER_TAP_READBACKS; i++) {
+		if (tap->readbacks[i].fence) {
+			glDeleteSync(tap->readbacks[i].fence);
+		}
+		if (tap->readbacks[i].pbo) {
+			glDeleteBuffers(1, &tap->readbacks[i].pbo);
+		}
+	}
+	if (tap->texture) {
+		glDeleteTextures(1, &tap->texture);
+		glDeleteFramebuffers(1, &tap->fbo);
+		glDeleteFramebuffers(1, &tap->source);
+	}
+	tap_unref(tap);
+}
+
+void av_media_player_release_frame(void* ring) {
+	tap_ring_unref(ring);
+}
+
+void av_media_player_set_frame_callback(AvMediaPlayerFrameCallback callback, void* user) {
+	g_mutex_lock(&taps.mutex);
+	taps.callback = callback;
+	taps.user = user;
+	g_mutex_unlock(&taps.mutex);
+}
@@ -0,0 +1,34 @@
+#ifndef AV_MEDIA_PLAYER_TAP_H_
+#define AV_MEDIA_PLAYER_TAP_H_
+
+#include "include/av_media_player/av_media_player_plugin.h"
+#include <epoxy/gl.h>
+
+// continuous frame tap of a player. frames are scaled on the gpu and read back through pixel buffers without
+// waiting, then converted in a worker thread into a ring of slots that dart reads through ffi. each slot starts
+// with a header of AV_MEDIA_PLAYER_TAP_HEADER bytes: uint64 sequence (0 while it's written), int64 pts in
+// milliseconds, uint32 width, uint32 height, uint32 format and uint32 size of the data that follows
+#define AV_MEDIA_PLAYER_TAP_HEADER 32
+#define AV_MEDIA_PLAYER_TAP_SLOTS 4
+
+typedef struct _AvMediaPlayerTap AvMediaPlayerTap;
+
+// called in the main thread once a frame is in its slot. returns TRUE if the frame was handed to dart,
+// which then owns a reference of ring and releases it with av_media_player_release_frame
+typedef gboolean (*AvMediaPlayerTapDone)(int64_t id, void* ring, const uint8_t* slot, const AvMediaPlayerFrame* frame, uint64_t sequence);
+
+// format is 0 for rgba or 1 for nv12, the longest side of frames is at most maxSize
+AvMediaPlayerTap* av_media_player_tap_new(int64_t id, uint32_t format, uint16_t maxSize, double frameRate, AvMediaPlayerTapDone done);
+
+// called in the render thread right after a frame was rendered into texture, returns TRUE while frames are read back,
+// then it has to be called again even without new frames
+gboolean av_media_player_tap_update(AvMediaPlayerTap* tap, GLuint texture, GLsizei width, GLsizei height, int64_t pts);
+
+// stops reporting frames, called in the main thread when the tap is replaced before it's freed in the render thread
+void av_media_player_tap_close(AvMediaPlayerTap* tap);
+
+// called in the render thread, deletes the gl objects. the ring is freed once pending frames are converted
+// and dart released its frames
+void av_media_player_tap_free(AvMediaPlayerTap* tap);
+
+#endif
@@ -2,6 +2,7 @@
 #define FLUTTER_PLUGIN_AV_MEDIA_PLAYER_PLUGIN_H_
 
 #include <flutter_linux/flutter_linux.h>
+#include <stdint.h>
 
 G_BEGIN_DECLS
 
@@ -13,6 +14,42 @@ G_BEGIN_DECLS
 
 FLUTTER_PLUGIN_EXPORT void av_media_player_plugin_register_with_registrar(FlPluginRegistrar*);
 
+// a source that players read through callbacks, it's opened as avstream://<name>
+typedef struct {
+	// returns the size in bytes, or -1 if it's unknown
+	int64_t (*size)(void* user);
+	// reads up to length bytes at offset into buffer, returns the bytes read, 0 at the end or -1 on error.
+	// it's called from player threads, and possibly for several readers at once
+	int64_t (*read)(void* user, int64_t offset, char* buffer, uint64_t length);
+	// called once the source is unregistered and no player reads it anymore, can be NULL
+	void (*close)(void* user);
+} AvMediaPlayerStreamProvider;
+
+// returns FALSE if name is already registered
+FLUTTER_PLUGIN_EXPORT gboolean av_media_player_register_stream(const gchar* name, const AvMediaPlayerStreamProvider* provider, void* user);
+
+FLUTTER_PLUGIN_EXPORT void av_media_player_unregister_stream(const gchar* name);
+
+// a frame delivered by the frame tap of a player, see setFrameTap in dart
+typedef struct {
+	int64_t pts;     // in milliseconds
+	uint32_t width;
+	uint32_t height;
+	uint32_t format; // 0: rgba, 1: nv12 with the interleaved uv plane right after the y plane
+	uint32_t size;   // bytes of data
+	const uint8_t* data;
+} AvMediaPlayerFrame;
+
+// called from a worker thread for each tapped frame of any player, player is the id of the player in dart.
+// data is only valid during the call
+typedef void (*AvMediaPlayerFrameCallback)(int64_t player, const AvMediaPlayerFrame* frame, void* user);
+
+// sets the callback for tapped frames, NULL removes it
+FLUTTER_PLUGIN_EXPORT void av_media_player_set_frame_callback(AvMediaPlayerFrameCallback callback, void* user);
+
+// releases the memory of a tapped frame reported to dart, called through ffi once dart no longer references it
+FLUTTER_PLUGIN_EXPORT void av_media_player_release_frame(void* ring);
+
 G_END_DECLS
 
 #endif  // FLUTTER_PLUGIN_AV_MEDIA_PLAYER_PLUGIN_H_